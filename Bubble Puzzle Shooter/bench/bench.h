@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+/*
+ * Minimal timing helpers shared by the standalone benchmarks of this folder. They are not
+ * part of the game project: every benchmark is a single source with its own main(), built
+ * with the command given at its top.
+ */
+namespace bench
+{
+	/* Written by keep(), so the optimizer cannot drop the measured work */
+	inline volatile size_t Sink = 0;
+
+	inline void keep(size_t value) { Sink = Sink + value; }
+
+	/* Best wall time of action over runs calls, in nanoseconds */
+	template<typename _Func>
+	double measure(size_t runs, _Func&& action)
+	{
+		double best = 0;
+		for (size_t i = 0; i < runs; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			action();
+			const auto end = std::chrono::steady_clock::now();
+
+			const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			best = i == 0 ? ns : std::min(best, ns);
+		}
+		return best;
+	}
+
+	inline void report(const char* name, double ns, size_t items)
+	{
+		std::printf("  %-36s %12.0f ns %10.2f ns/item\n", name, ns, items ? ns / static_cast<double>(items) : ns);
+	}
+
+	inline void compare(const char* name, double baseline, double candidate)
+	{
+		std::printf("  %-36s %11.2fx\n", name, candidate > 0 ? baseline / candidate : 0.0);
+	}
+}
@@ -0,0 +1,245 @@
+/*
+ * Cluster detection of BubbleBoard with BoardMask flood fills against the naive BFS over
+ * the cell grid it replaced, on random boards of every column style and both parities.
+ * Both follow the rules of BubbleBoard::findCluster, and every cluster is checked to be
+ * the same before any timing is reported.
+ *
+ * Build from this folder, optimized (only the headers of the game are needed):
+ *   g++ -std=c++20 -O2 -I../src -I../libs/headers board_cluster.cpp -o board_cluster
+ *   cl /std:c++20 /O2 /EHsc /I..\src /I..\libs\headers board_cluster.cpp
+ */
+#include "bench.h"
+
+#include <random>
+#include <vector>
+
+#include "board.h"
+
+
+namespace
+{
+	constexpr UInt32 ColorCount = 8;
+	constexpr Int8 Empty = -1;
+	constexpr Int8 Multicolor = ColorCount;
+	constexpr Int8 Colorless = ColorCount + 1;
+
+	/* The same board twice: one cell code per index for the BFS and the masks BubbleBoard keeps */
+	struct Board
+	{
+		BoardColumnStyle style;
+		UInt32 parity;
+		std::array<Int8, utils::BoardCellCount> cells;
+
+		BoardMask occupied;
+		BoardMask multicolor;
+		BoardMask colorless;
+		std::array<BoardMask, ColorCount> colors;
+	};
+
+	/* Fewer colors in play make larger clusters */
+	Board makeBoard(std::mt19937& rand, BoardColumnStyle style, UInt32 parity, Row filledRows, UInt32 colorsInPlay)
+	{
+		Board board{ style, parity, {}, {}, {}, {}, {} };
+		board.cells.fill(Empty);
+
+		const BoardMask valid = BoardMask::valid(style, parity);
+		std::uniform_int_distribution<UInt32> percent{ 0, 99 };
+		std::uniform_int_distribution<UInt32> color{ 0, colorsInPlay - 1 };
+
+		for (Row row = 0; row < filledRows; row++)
+		{
+			for (Column column = 0; column < utils::MaxColumnCount; column++)
+			{
+				const UInt32 index = row * utils::MaxColumnCount + column;
+				if (!valid.test(index))
+					continue;
+
+				const UInt32 roll = percent(rand);
+				if (roll < 15)
+					continue;
+
+				Int8 code = static_cast<Int8>(color(rand));
+				if (roll < 18)
+					code = Multicolor;
+				else if (roll < 20)
+					code = Colorless;
+
+				board.cells[index] = code;
+				board.occupied.set(index);
+				if (code == Multicolor)
+					board.multicolor.set(index);
+				else if (code == Colorless)
+					board.colorless.set(index);
+				else
+					board.colors[code].set(index);
+			}
+		}
+		return board;
+	}
+
+
+
+	/* BubbleBoard::findCluster */
+	BoardMask maskCluster(const Board& board, UInt32 index)
+	{
+		BoardMask seed;
+		seed.set(index);
+		if (board.colorless.test(index))
+			return seed;
+
+		if (!board.multicolor.test(index))
+		{
+			for (const BoardMask& color : board.colors)
+				if (color.test(index))
+					return BoardMask::floodFill(seed, color | board.multicolor, board.parity);
+			return seed;
+		}
+
+		BoardMask cluster = seed;
+		const BoardMask reach = BoardMask::floodFill(seed, board.multicolor, board.parity).expanded(board.parity);
+		for (const BoardMask& color : board.colors)
+			if ((reach & color).any())
+				cluster |= BoardMask::floodFill(seed, color | board.multicolor, board.parity);
+		return cluster;
+	}
+
+
+
+	/* Breadth first search over the cell codes, one neighbor table lookup per visited cell */
+	class NaiveCluster
+	{
+	private:
+		std::array<UInt16, utils::BoardCellCount> _queue;
+		std::array<bool, utils::BoardCellCount> _visited;
+
+	public:
+		BoardMask find(const Board& board, UInt32 index)
+		{
+			BoardMask cluster;
+			cluster.set(index);
+
+			const Int8 code = board.cells[index];
+			if (code == Colorless)
+				return cluster;
+
+			if (code != Multicolor)
+			{
+				search(board, index, [code](Int8 cell) { return cell == code || cell == Multicolor; }, cluster);
+				return cluster;
+			}
+
+			/* Every color next to the multicolor group the seed belongs to */
+			std::array<bool, ColorCount> touched{};
+			BoardMask group;
+			search(board, index, [](Int8 cell) { return cell == Multicolor; }, group);
+			group.forEach([&](UInt32 member) {
+				forEachNeighbor(board, member, [&](UInt32 neighbor) {
+					const Int8 cell = board.cells[neighbor];
+					if (cell >= 0 && cell < static_cast<Int8>(ColorCount))
+						touched[cell] = true;
+				});
+			});
+
+			for (Int8 color = 0; color < static_cast<Int8>(ColorCount); color++)
+				if (touched[color])
+					search(board, index, [color](Int8 cell) { return cell == color || cell == Multicolor; }, cluster);
+			return cluster;
+		}
+
+	private:
+		template<typename _Func>
+		static void forEachNeighbor(const Board& board, UInt32 index, _Func&& action)
+		{
+			const Row row = static_cast<Row>(index / utils::MaxColumnCount);
+			const Column column = static_cast<Column>(index % utils::MaxColumnCount);
+			const utils::NeighborOffsets& offsets = utils::neighborOffsets(board.style, row + board.parity, column);
+			for (UInt8 i = 0; i < offsets.count; i++)
+			{
+				const Int32 target = static_cast<Int32>(row) + offsets.offsets[i].row;
+				if (target >= 0 && target < static_cast<Int32>(utils::TotalRows))
+					action(static_cast<UInt32>(target) * utils::MaxColumnCount + column + offsets.offsets[i].column);
+			}
+		}
+
+		template<typename _Func>
+		void search(const Board& board, UInt32 index, _Func&& matches, BoardMask& result)
+		{
+			_visited.fill(false);
+			UInt32 head = 0, tail = 0;
+
+			_queue[tail++] = static_cast<UInt16>(index);
+			_visited[index] = true;
+			result.set(index);
+
+			while (head < tail)
+			{
+				forEachNeighbor(board, _queue[head++], [&](UInt32 neighbor) {
+					if (_visited[neighbor] || !matches(board.cells[neighbor]))
+						return;
+					_visited[neighbor] = true;
+					result.set(neighbor);
+					_queue[tail++] = static_cast<UInt16>(neighbor);
+				});
+			}
+		}
+	};
+}
+
+
+
+int main()
+{
+	constexpr size_t Runs = 20;
+	constexpr UInt32 BoardsPerStyle = 16;
+	constexpr Row FilledRows[] = { 6, 12, utils::TotalRows };
+	constexpr UInt32 ColorsInPlay[] = { 3, ColorCount };
+
+	std::mt19937 rand{ 0xB0BB1E };
+	NaiveCluster naive;
+
+	std::printf("findCluster, bitboard flood fill vs naive BFS, with multicolor and colorless cells\n");
+
+	for (const UInt32 colorsInPlay : ColorsInPlay)
+	{
+		for (const Row filled : FilledRows)
+		{
+			std::vector<Board> boards;
+			for (Column columns = utils::MinColumnCount; columns <= utils::MaxColumnCount; columns++)
+				for (UInt32 i = 0; i < BoardsPerStyle; i++)
+					boards.push_back(makeBoard(rand, static_cast<BoardColumnStyle>(columns), i & 1, filled, colorsInPlay));
+
+			/* Every occupied cell is a seed, as if a bubble had just landed there */
+			size_t seeds = 0, cells = 0, mismatches = 0;
+			for (const Board& board : boards)
+			{
+				board.occupied.forEach([&](UInt32 index) {
+					const BoardMask cluster = maskCluster(board, index);
+					seeds++;
+					cells += cluster.count();
+					if (!(cluster == naive.find(board, index)))
+						mismatches++;
+				});
+			}
+
+			std::printf("\n%u colors, %u filled rows, %zu boards, %zu seeds, %.1f cells per cluster: %zu mismatches\n",
+				colorsInPlay, filled, boards.size(), seeds, static_cast<double>(cells) / static_cast<double>(seeds), mismatches);
+			if (mismatches)
+				return 1;
+
+			const double bfs = bench::measure(Runs, [&]() {
+				for (const Board& board : boards)
+					board.occupied.forEach([&](UInt32 index) { bench::keep(naive.find(board, index).count()); });
+			});
+			const double mask = bench::measure(Runs, [&]() {
+				for (const Board& board : boards)
+					board.occupied.forEach([&](UInt32 index) { bench::keep(maskCluster(board, index).count()); });
+			});
+
+			bench::report("naive BFS", bfs, seeds);
+			bench::report("BoardMask flood fill", mask, seeds);
+			bench::compare("speedup", bfs, mask);
+		}
+	}
+
+	return 0;
+}
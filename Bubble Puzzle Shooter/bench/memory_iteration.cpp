@@ -0,0 +1,100 @@
+/*
+ * Template visitors of MemoryAllocator against the std::function taking versions they
+ * replaced, plus the range-for over AllocatorIterator, over 10k live objects.
+ *
+ * Build from this folder, optimized:
+ *   g++ -std=c++20 -O2 -I../src -I../libs/headers memory_iteration.cpp ../src/memory.cpp ../src/common.cpp -o memory_iteration
+ *   cl /std:c++20 /O2 /EHsc /I..\src /I..\libs\headers memory_iteration.cpp ..\src\memory.cpp ..\src\common.cpp
+ */
+#include "bench.h"
+
+#include <functional>
+#include <vector>
+
+#include "memory.h"
+
+
+class Payload
+{
+public:
+	size_t value;
+	bool flagged;
+
+	Payload(size_t value) : value{ value }, flagged{ value % 7 == 0 } {}
+	virtual ~Payload() {}
+};
+
+
+
+/* The old signatures: std::function by value, so one type-erased call per element */
+#if defined(_MSC_VER)
+#	define BENCH_NOINLINE __declspec(noinline)
+#else
+#	define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE static void forEachFunction(MemoryAllocator<Payload>& alloc, std::function<void(Payload&)> action)
+{
+	alloc.forEach(action);
+}
+
+BENCH_NOINLINE static std::vector<Ref<Payload>> findFunction(const MemoryAllocator<Payload>& alloc, std::function<bool(const Payload&)> criteria)
+{
+	return alloc.find(criteria);
+}
+
+int main()
+{
+	constexpr size_t Count = 10000;
+	constexpr size_t Runs = 50;
+
+	MemoryAllocator<Payload> alloc;
+	for (size_t i = 0; i < Count; i++)
+		alloc.alloc<Payload>(i);
+
+	std::printf("%zu objects\n", Count);
+
+	const double function = bench::measure(Runs, [&alloc]() {
+		size_t sum = 0;
+		forEachFunction(alloc, [&sum](Payload& obj) { sum += obj.value; });
+		bench::keep(sum);
+	});
+	const double visitor = bench::measure(Runs, [&alloc]() {
+		size_t sum = 0;
+		alloc.forEach([&sum](Payload& obj) { sum += obj.value; });
+		bench::keep(sum);
+	});
+	const double range = bench::measure(Runs, [&alloc]() {
+		size_t sum = 0;
+		for (Payload& obj : alloc)
+			sum += obj.value;
+		bench::keep(sum);
+	});
+	const double ofType = bench::measure(Runs, [&alloc]() {
+		size_t sum = 0;
+		alloc.forEachOfType<Payload>([&sum](Payload& obj) { sum += obj.value; });
+		bench::keep(sum);
+	});
+
+	bench::report("forEach, std::function", function, Count);
+	bench::report("forEach, template visitor", visitor, Count);
+	bench::report("range-for, AllocatorIterator", range, Count);
+	bench::report("forEachOfType", ofType, Count);
+
+	const double findFunc = bench::measure(Runs, [&alloc]() {
+		bench::keep(findFunction(alloc, [](const Payload& obj) { return obj.flagged; }).size());
+	});
+	const double findTemplate = bench::measure(Runs, [&alloc]() {
+		bench::keep(alloc.find([](const Payload& obj) { return obj.flagged; }).size());
+	});
+
+	bench::report("find, std::function", findFunc, Count);
+	bench::report("find, template predicate", findTemplate, Count);
+
+	std::printf(" speedup over std::function\n");
+	bench::compare("forEach, template visitor", function, visitor);
+	bench::compare("range-for, AllocatorIterator", function, range);
+	bench::compare("forEachOfType", function, ofType);
+	bench::compare("find, template predicate", findFunc, findTemplate);
+	return 0;
+}
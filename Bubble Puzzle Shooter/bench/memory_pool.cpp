@@ -0,0 +1,240 @@
+/*
+ * MemoryAllocator slab pools against the node list they replaced: one heap allocation for
+ * the object plus one for its doubly linked node, walked through pointers.
+ *
+ * Build from this folder, optimized:
+ *   g++ -std=c++20 -O2 -I../src -I../libs/headers memory_pool.cpp ../src/memory.cpp ../src/common.cpp -o memory_pool
+ *   cl /std:c++20 /O2 /EHsc /I..\src /I..\libs\headers memory_pool.cpp ..\src\memory.cpp ..\src\common.cpp
+ */
+#include "bench.h"
+
+#include <vector>
+
+#include "memory.h"
+
+
+/*
+ * Stand-in for Bubble: polymorphic and a few cache lines big. It does not derive from Object,
+ * so the ID index, which the old list did not have, stays out of the comparison.
+ */
+class Payload
+{
+public:
+	float position[4] = {};
+	unsigned char sprite[160] = {};
+	size_t value;
+
+	explicit Payload(size_t value) : value{ value } {}
+	virtual ~Payload() {}
+};
+
+
+
+/* The allocator list before the slab pools, reduced to what the benchmark needs */
+template<typename _Base>
+class LegacyList
+{
+public:
+	struct Node
+	{
+		_Base* data;
+		Node* next;
+		Node* prev;
+
+		~Node() { delete data; }
+	};
+
+private:
+	Node* _head = nullptr;
+	Node* _tail = nullptr;
+	size_t _size = 0;
+
+public:
+	LegacyList() = default;
+	~LegacyList() { clear(); }
+
+	LegacyList(const LegacyList&) = delete;
+	LegacyList& operator= (const LegacyList&) = delete;
+
+	template<typename _Ty, typename... _Args>
+	Node* create(_Args&&... args)
+	{
+		Node* node = new Node{ new _Ty(std::forward<_Args>(args)...), nullptr, _tail };
+		if (_tail)
+			_tail->next = node;
+		else _head = node;
+		_tail = node;
+		_size++;
+		return node;
+	}
+
+	void destroy(Node* node)
+	{
+		if (node->prev)
+			node->prev->next = node->next;
+		else _head = node->next;
+		if (node->next)
+			node->next->prev = node->prev;
+		else _tail = node->prev;
+		_size--;
+		delete node;
+	}
+
+	template<typename _Func>
+	void forEach(_Func&& action)
+	{
+		for (Node* node = _head; node; node = node->next)
+			action(*node->data);
+	}
+
+	void clear()
+	{
+		while (_head)
+		{
+			Node* next = _head->next;
+			delete _head;
+			_head = next;
+		}
+		_tail = nullptr;
+		_size = 0;
+	}
+};
+
+
+
+struct Timings
+{
+	double create = 0;
+	double iterate = 0;
+	double churn = 0;
+	double release = 0;
+};
+
+/* Best time from the point action sets start until it returns, to leave the setup out */
+template<typename _Func>
+static double measure(size_t runs, _Func&& action)
+{
+	double best = 0;
+	for (size_t i = 0; i < runs; i++)
+	{
+		std::chrono::steady_clock::time_point start;
+		action(start);
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		best = i == 0 ? ns : std::min(best, ns);
+	}
+	return best;
+}
+
+/* Fills count objects, walks them, pops every other one and refills, then drops everything */
+static Timings runLegacy(size_t count, size_t runs)
+{
+	Timings t;
+	t.create = bench::measure(runs, [count]() {
+		LegacyList<Payload> list;
+		for (size_t i = 0; i < count; i++)
+			list.create<Payload>(i);
+		bench::keep(count);
+	});
+
+	LegacyList<Payload> list;
+	std::vector<LegacyList<Payload>::Node*> nodes;
+	for (size_t i = 0; i < count; i++)
+		nodes.push_back(list.create<Payload>(i));
+
+	t.iterate = bench::measure(runs, [&list]() {
+		size_t sum = 0;
+		list.forEach([&sum](Payload& obj) { sum += obj.value; });
+		bench::keep(sum);
+	});
+
+	t.churn = bench::measure(runs, [&list, &nodes]() {
+		for (size_t i = 0; i < nodes.size(); i += 2)
+			list.destroy(nodes[i]);
+		for (size_t i = 0; i < nodes.size(); i += 2)
+			nodes[i] = list.create<Payload>(i);
+	});
+
+	t.release = measure(runs, [count](auto& start) {
+		LegacyList<Payload> scratch;
+		for (size_t i = 0; i < count; i++)
+			scratch.create<Payload>(i);
+		start = std::chrono::steady_clock::now();
+		scratch.clear();
+	});
+	return t;
+}
+
+static Timings runPool(size_t count, size_t runs, bool arena)
+{
+	Timings t;
+	t.create = bench::measure(runs, [count, arena]() {
+		MemoryAllocator<Payload> alloc;
+		alloc.setArenaMode(arena);
+		for (size_t i = 0; i < count; i++)
+			alloc.alloc<Payload>(i);
+		bench::keep(alloc.size());
+	});
+
+	MemoryAllocator<Payload> alloc;
+	std::vector<Ref<Payload>> refs;
+	for (size_t i = 0; i < count; i++)
+		refs.push_back(alloc.alloc<Payload>(i));
+
+	t.iterate = bench::measure(runs, [&alloc]() {
+		size_t sum = 0;
+		alloc.forEach([&sum](Payload& obj) { sum += obj.value; });
+		bench::keep(sum);
+	});
+
+	/* Arena mode never reuses cells, so churn is only meaningful for the regular pools */
+	t.churn = arena ? 0 : bench::measure(runs, [&alloc, &refs]() {
+		for (size_t i = 0; i < refs.size(); i += 2)
+			alloc.free(refs[i]);
+		for (size_t i = 0; i < refs.size(); i += 2)
+			refs[i] = alloc.alloc<Payload>(i);
+	});
+
+	t.release = measure(runs, [count, arena](auto& start) {
+		MemoryAllocator<Payload> scratch;
+		scratch.setArenaMode(arena);
+		for (size_t i = 0; i < count; i++)
+			scratch.alloc<Payload>(i);
+		start = std::chrono::steady_clock::now();
+		scratch.clear();
+	});
+	return t;
+}
+
+static void print(const char* title, const Timings& t, size_t count)
+{
+	std::printf(" %s\n", title);
+	bench::report("create", t.create, count);
+	bench::report("iterate", t.iterate, count);
+	if (t.churn > 0)
+		bench::report("free and refill half", t.churn, count);
+	bench::report("release all", t.release, count);
+}
+
+int main()
+{
+	constexpr size_t Runs = 15;
+	for (size_t count : { 288, 2000, 20000 })
+	{
+		std::printf("%zu objects of %zu bytes\n", count, sizeof(Payload));
+		const Timings legacy = runLegacy(count, Runs);
+		const Timings pool = runPool(count, Runs, false);
+		const Timings arena = runPool(count, Runs, true);
+		print("node list", legacy, count);
+		print("slab pools", pool, count);
+		print("slab pools, arena mode", arena, count);
+
+		std::printf(" speedup of the slab pools\n");
+		bench::compare("create", legacy.create, pool.create);
+		bench::compare("iterate", legacy.iterate, pool.iterate);
+		bench::compare("free and refill half", legacy.churn, pool.churn);
+		bench::compare("release all", legacy.release, pool.release);
+		bench::compare("release all, arena mode", legacy.release, arena.release);
+		std::printf("\n");
+	}
+	return 0;
+}
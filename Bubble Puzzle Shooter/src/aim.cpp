@@ -0,0 +1,74 @@
+#include "aim.h"
+
+#include <cmath>
+#include <numbers>
+
+
+AimPredictor::AimPredictor(const BubbleBoard& board) :
+	_board{ board },
+	_walls{},
+	_launcher{},
+	_maxLength{ 0 },
+	_cache{}
+{}
+AimPredictor::~AimPredictor() {}
+
+void AimPredictor::setup(const LevelProperties& props, const BouncingBounds& bounds)
+{
+	setWalls(SweepWalls::from(bounds, props.isRoofEnabled()));
+	const sf::IntRect& rect = _walls.bounds;
+	setMaxLength(static_cast<float>(rect.width + rect.height) * 4);
+}
+
+const SweepWalls& AimPredictor::getWalls() const { return _walls; }
+void AimPredictor::setWalls(const SweepWalls& walls)
+{
+	_walls = walls;
+	invalidate();
+}
+
+const Vec2f& AimPredictor::getLauncher() const { return _launcher; }
+void AimPredictor::setLauncher(const Vec2f& launcher)
+{
+	if (launcher != _launcher)
+	{
+		_launcher = launcher;
+		invalidate();
+	}
+}
+
+float AimPredictor::getMaxLength() const { return _maxLength; }
+void AimPredictor::setMaxLength(float length)
+{
+	_maxLength = length;
+	invalidate();
+}
+
+const AimPredictor::Prediction& AimPredictor::predict(float angle)
+{
+	const Int32 key = quantize(angle);
+	Entry& entry = _cache[static_cast<UInt32>(key) % CacheSize];
+	if (entry.valid && entry.angle == key && entry.version == _board.getVersion())
+		return entry.prediction;
+
+	/* Unit speed, so the sweep time is the path length */
+	const float radians = static_cast<float>(key) * AngleStep * std::numbers::pi_v<float> / 180.f;
+	const Vec2f direction = { std::cos(radians), -std::sin(radians) };
+
+	Prediction& prediction = entry.prediction;
+	prediction.path.count = 0;
+	const BoardSweep sweep = _board.sweep(_launcher, direction, _maxLength, _walls, &prediction.path);
+	prediction.landed = sweep.hit && sweep.snapped;
+	prediction.cell = sweep.snap;
+
+	entry.angle = key;
+	entry.version = _board.getVersion();
+	entry.valid = true;
+	return prediction;
+}
+
+void AimPredictor::invalidate()
+{
+	for (Entry& entry : _cache)
+		entry.valid = false;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "board.h"
+
+
+/*
+ * Aim guide for the launcher. Predictions are cached per quantized angle in a small
+ * direct-mapped table and stay valid until the board, the walls or the launcher change.
+ * Angles are in degrees, 90 pointing straight up.
+ */
+class AimPredictor
+{
+public:
+	static constexpr float AngleStep = 0.25f;
+	static constexpr UInt32 CacheSize = 64;
+
+	struct Prediction
+	{
+		SweepPath path;
+		bool landed = false;
+		BoardCell cell = {};
+	};
+
+private:
+	struct Entry
+	{
+		Int32 angle = 0;
+		UInt32 version = 0;
+		bool valid = false;
+		Prediction prediction;
+	};
+
+	const BubbleBoard& _board;
+	SweepWalls _walls;
+	Vec2f _launcher;
+	float _maxLength;
+	std::array<Entry, CacheSize> _cache;
+
+public:
+	AimPredictor(const BubbleBoard& board);
+	~AimPredictor();
+
+	NON_COPYABLE_MOVABLE(AimPredictor);
+
+	/* Walls of the shot bubble, with the roof taken from the level */
+	void setup(const LevelProperties& props, const BouncingBounds& bounds);
+
+	const SweepWalls& getWalls() const;
+	void setWalls(const SweepWalls& walls);
+
+	const Vec2f& getLauncher() const;
+	void setLauncher(const Vec2f& launcher);
+
+	/* Longest path followed before giving up on a landing cell */
+	float getMaxLength() const;
+	void setMaxLength(float length);
+
+	const Prediction& predict(float angle);
+
+	inline const Prediction& predict(const Vec2f& launcher, float angle)
+	{
+		setLauncher(launcher);
+		return predict(angle);
+	}
+
+	void invalidate();
+
+	static constexpr Int32 quantize(float angle) { return static_cast<Int32>(angle / AngleStep + (angle < 0 ? -0.5f : 0.5f)); }
+};
@@ -9,6 +9,19 @@
 using sf::Texture;
 using sf::Sprite;
 
+namespace memory
+{
+	template<>
+	struct Footprint<Texture>
+	{
+		static size_t bytes(const Texture& texture)
+		{
+			const Vec2u size = texture.getSize();
+			return static_cast<size_t>(size.x) * static_cast<size_t>(size.y) * 4;
+		}
+	};
+}
+
 class TextureManager : public Manager<Texture>
 {
 public:
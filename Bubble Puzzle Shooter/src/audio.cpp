@@ -54,24 +54,58 @@ bool Music::operator! () const { return !_music; }
 
 
 SoundManager::SoundManager(int) :
-	Manager{ nullptr }
+	Manager{ nullptr },
+	_buffers{},
+	_soundBuffers{}
 {}
 SoundManager::SoundManager(SoundManager* parent) :
-	Manager{ parent ? parent : &RootManager }
+	Manager{ parent ? parent : &RootManager },
+	_buffers{},
+	_soundBuffers{}
 {}
-SoundManager::~SoundManager() {}
+SoundManager::~SoundManager()
+{
+	/* Sounds detach from their buffers on destruction, so they must go first */
+	clear();
+}
 
 bool SoundManager::load(const std::string& filepath, const std::string& name)
 {
-	sf::SoundBuffer buffer;
-	if (!buffer.loadFromFile(ResourcePoint::Sounds + filepath))
+	if (has(name))
 		return false;
 
+	auto buffer = _buffers.alloc<SoundBuffer>();
+	if (!buffer->loadFromFile(ResourcePoint::Sounds + filepath))
+	{
+		_buffers.free(buffer);
+		return false;
+	}
+
 	auto sound = create<Sound>(name);
-	sound->setBuffer(std::move(buffer));
+	sound->setBuffer(*buffer);
+	_soundBuffers[name] = buffer;
 	return true;
 }
 
+std::vector<memory::AllocationStats> SoundManager::getBufferAllocationStats() const { return _buffers.stats(); }
+
+void SoundManager::onDestroy(const std::string& name, Sound& sound)
+{
+	auto it = _soundBuffers.find(name);
+	if (it == _soundBuffers.end())
+		return;
+
+	sound.resetBuffer();
+	_buffers.free(it->second);
+	_soundBuffers.erase(it);
+}
+
+void SoundManager::onClear()
+{
+	_soundBuffers.clear();
+	_buffers.clear();
+}
+
 SoundManager& SoundManager::root() { return RootManager; }
 
 SoundManager SoundManager::RootManager(0);
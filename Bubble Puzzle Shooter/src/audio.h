@@ -5,6 +5,16 @@
 #include "manager.h"
 
 using sf::Sound;
+using sf::SoundBuffer;
+
+namespace memory
+{
+	template<>
+	struct Footprint<SoundBuffer>
+	{
+		static size_t bytes(const SoundBuffer& buffer) { return static_cast<size_t>(buffer.getSampleCount()) * sizeof(sf::Int16); }
+	};
+}
 
 class Music
 {
@@ -36,12 +46,22 @@ public:
 
 class SoundManager : public Manager<Sound>
 {
+private:
+	MemoryAllocator<SoundBuffer> _buffers;
+	std::map<std::string, Ref<SoundBuffer>> _soundBuffers;
+
 public:
 	SoundManager(SoundManager* parent = nullptr);
 	~SoundManager();
 
 	bool load(const std::string& filepath, const std::string& name);
 
+	std::vector<memory::AllocationStats> getBufferAllocationStats() const;
+
+protected:
+	void onDestroy(const std::string& name, Sound& sound) override;
+	void onClear() override;
+
 private:
 	static SoundManager RootManager;
 
@@ -0,0 +1,653 @@
+#include "board.h"
+
+#include <cmath>
+#include <limits>
+
+
+ZobristKeys::ZobristKeys(RNG::Seed seed) :
+	_seed{ seed },
+	_columns{},
+	_parity{ 0 }
+{
+	/* SplitMix64 stream, so the keys are the same on every platform */
+	UInt64 state = seed;
+	const auto next = [&state]() { return mix(state += 0x9e3779b97f4a7c15ULL); };
+	for (UInt64& key : _columns)
+		key = next();
+	_parity = next();
+}
+
+RNG::Seed ZobristKeys::getSeed() const { return _seed; }
+UInt64 ZobristKeys::getParityKey() const { return _parity; }
+
+
+
+
+
+
+BubbleBoard::BubbleBoard(BoardColumnStyle columns) :
+	_cells{},
+	_columns{ columns },
+	_origin{},
+	_count{ 0 },
+	_version{ 0 },
+	_firstRow{ 0 },
+	_descents{ 0 },
+	_keys{},
+	_hash{ 0 },
+	_valid{ BoardMask::valid(columns) },
+	_occupied{},
+	_colorless{},
+	_multicolor{},
+	_colors{},
+	_colorCounts{},
+	_colorsPresent{ 0 },
+	_floating{},
+	_anchored{},
+	_popped{}
+{}
+BubbleBoard::~BubbleBoard() {}
+
+void BubbleBoard::setup(const LevelProperties& props)
+{
+	setColumnStyle(props.getColuns());
+	setHashSeed(props.getSeed());
+}
+
+BoardColumnStyle BubbleBoard::getColumnStyle() const { return _columns; }
+void BubbleBoard::setColumnStyle(BoardColumnStyle columns)
+{
+	_columns = columns;
+	clear();
+}
+
+const Vec2f& BubbleBoard::getOrigin() const { return _origin; }
+void BubbleBoard::setOrigin(const Vec2f& origin)
+{
+	_origin = origin;
+	_version++;
+}
+
+Column BubbleBoard::getColumnCount(Row row) const { return utils::adaptIfIsOdd(row + getParity(), _columns); }
+bool BubbleBoard::isValidCell(Row row, Column column) const { return row < utils::TotalRows && column < getColumnCount(row); }
+
+bool BubbleBoard::isPairRow(Row row) const { return utils::isPairRow(row + getParity()); }
+UInt32 BubbleBoard::getParity() const { return _descents & 0x1; }
+
+UInt32 BubbleBoard::getDescentCount() const { return _descents; }
+
+sf::Transform BubbleBoard::getScrollTransform() const
+{
+	sf::Transform transform;
+	transform.translate(0, static_cast<float>(_descents) * RowHeight);
+	return transform;
+}
+
+UInt32 BubbleBoard::size() const { return _count; }
+bool BubbleBoard::empty() const { return _count == 0; }
+
+UInt32 BubbleBoard::getVersion() const { return _version; }
+
+UInt64 BubbleBoard::getHash() const { return getParity() ? _hash ^ _keys.getParityKey() : _hash; }
+UInt64 BubbleBoard::computeHash() const
+{
+	UInt64 hash = getParity() ? _keys.getParityKey() : 0;
+	_occupied.forEach([this, &hash](UInt32 index) {
+		const BoardCell cell = indexToCell(index);
+		hash ^= keyOf(cell.row, cell.column, getBubble(cell.row, cell.column));
+	});
+	return hash;
+}
+bool BubbleBoard::verifyHash() const { return computeHash() == getHash(); }
+
+const ZobristKeys& BubbleBoard::getHashKeys() const { return _keys; }
+void BubbleBoard::setHashSeed(RNG::Seed seed)
+{
+	_keys = ZobristKeys(seed);
+	_hash = computeHash() ^ (getParity() ? _keys.getParityKey() : 0);
+}
+
+bool BubbleBoard::isEmpty(Row row, Column column) const { return !_cells[slotOf(cellIndex(row, column))]; }
+const Ref<Bubble>& BubbleBoard::getBubble(Row row, Column column) const { return _cells[slotOf(cellIndex(row, column))]; }
+
+bool BubbleBoard::attach(Row row, Column column, const Ref<Bubble>& bubble)
+{
+	if (!bubble || !isValidCell(row, column))
+		return false;
+
+	Ref<Bubble>& cell = _cells[slotOf(cellIndex(row, column))];
+	if (cell)
+		return false;
+
+	cell = bubble;
+	cell->setPosition(cellToScrolled(row, column));
+	_hash ^= keyOf(row, column, cell);
+	_count++;
+	_version++;
+
+	const UInt32 index = cellIndex(row, column);
+	_occupied.set(index);
+	switch (cell->getColorType())
+	{
+		case BubbleColorType::Colorless:
+			_colorless.set(index);
+			break;
+
+		case BubbleColorType::MultiColor:
+			_multicolor.set(index);
+			break;
+
+		case BubbleColorType::NormalColor: {
+			const UInt8 color = cell->getColor().index();
+			if (color < BubbleColor::Count)
+			{
+				_colors[color].set(index);
+				_colorCounts[color]++;
+				_colorsPresent += cell->getColor();
+			}
+			else _colorless.set(index);
+		} break;
+	}
+
+	if (cell->isFloating())
+		_floating.set(index);
+
+	/* A new anchor or a bubble touching the anchored region also anchors whatever hangs from it */
+	BoardMask seed;
+	seed.set(index);
+	if ((seed & getAnchorMask()).any() || (seed.expanded(getParity()) & _anchored).any())
+		_anchored |= BoardMask::floodFill(seed, _occupied - _anchored, getParity());
+
+	return true;
+}
+
+Ref<Bubble> BubbleBoard::pop(Row row, Column column)
+{
+	if (!isValidCell(row, column))
+		return nullptr;
+
+	const UInt32 index = cellIndex(row, column);
+	Ref<Bubble> bubble = release(index);
+	if (bubble)
+		_popped.set(index);
+	return bubble;
+}
+
+void BubbleBoard::pop(const BoardMask& cells, std::vector<Ref<Bubble>>& popped)
+{
+	const BoardMask removed = cells & _occupied;
+	removed.forEach([this, &popped](UInt32 index) { popped.push_back(release(index)); });
+	_popped |= removed;
+}
+
+void BubbleBoard::clear()
+{
+	_cells.fill(nullptr);
+	_count = 0;
+	_version++;
+	_firstRow = 0;
+	_descents = 0;
+	_hash = 0;
+	_valid = BoardMask::valid(_columns);
+	_occupied = {};
+	_colorless = {};
+	_multicolor = {};
+	_colors.fill({});
+	_colorCounts.fill(0);
+	_colorsPresent = 0;
+	_floating = {};
+	_anchored = {};
+	_popped = {};
+}
+
+void BubbleBoard::descend(std::span<const Ref<Bubble>> row, std::vector<Ref<Bubble>>& pushedOut)
+{
+	const BoardMask bottom = _occupied & utils::BottomRowMask;
+	bottom.forEach([this, &pushedOut](UInt32 index) { pushedOut.push_back(release(index)); });
+
+	/* The freed storage row becomes the roof row, every other row keeps its slot */
+	_firstRow = _firstRow == 0 ? utils::TotalRows - 1 : _firstRow - 1;
+	_descents++;
+	_version++;
+	_hash = std::rotl(_hash, 1);
+
+	const auto scroll = [](BoardMask& mask) { mask = (mask - utils::BottomRowMask).shiftedForward(utils::MaxColumnCount); };
+	scroll(_occupied);
+	scroll(_colorless);
+	scroll(_multicolor);
+	for (BoardMask& mask : _colors)
+		scroll(mask);
+	scroll(_floating);
+	scroll(_anchored);
+	scroll(_popped);
+	_valid = BoardMask::valid(_columns, getParity());
+
+	/* Whatever hung from the pushed out bubbles is now in the last row */
+	if (bottom.any())
+		_popped |= _occupied & utils::BottomRowMask;
+
+	for (Column column = 0; column < row.size(); column++)
+		if (row[column])
+			attach(0, column, row[column]);
+
+	_popped |= (utils::RoofMask & _valid) - _occupied;
+}
+
+UInt8 BubbleBoard::getNeighbors(Row row, Column column, BoardCell (&neighbors)[utils::MaxNeighbors]) const
+{
+	UInt8 count = 0;
+	forEachNeighbor(row, column, [&neighbors, &count](Row nrow, Column ncolumn) { neighbors[count++] = { nrow, ncolumn }; });
+	return count;
+}
+
+const BoardMask& BubbleBoard::getValidMask() const { return _valid; }
+const BoardMask& BubbleBoard::getOccupiedMask() const { return _occupied; }
+const BoardMask& BubbleBoard::getColorlessMask() const { return _colorless; }
+const BoardMask& BubbleBoard::getMulticolorMask() const { return _multicolor; }
+const BoardMask& BubbleBoard::getColorMask(const BubbleColor& color) const
+{
+	static const BoardMask empty{};
+	const UInt8 index = color.index();
+	return index < BubbleColor::Count ? _colors[index] : empty;
+}
+
+UInt32 BubbleBoard::getColorCount(const BubbleColor& color) const
+{
+	const UInt8 index = color.index();
+	return index < BubbleColor::Count ? _colorCounts[index] : 0;
+}
+BubbleColor::Mask BubbleBoard::getPresentColors() const { return _colorsPresent; }
+
+BoardMask BubbleBoard::findCluster(Row row, Column column) const
+{
+	BoardMask seed;
+	if (!isValidCell(row, column) || !_occupied.test(row, column))
+		return seed;
+
+	const UInt32 index = cellIndex(row, column);
+	seed.set(index);
+	if (_colorless.test(index))
+		return seed;
+
+	if (!_multicolor.test(index))
+	{
+		for (const BoardMask& color : _colors)
+			if (color.test(index))
+				return BoardMask::floodFill(seed, color | _multicolor, getParity());
+		return seed;
+	}
+
+	/* A multicolor bubble joins the cluster of every color it touches */
+	BoardMask cluster = seed;
+	const BoardMask reach = BoardMask::floodFill(seed, _multicolor, getParity()).expanded(getParity());
+	for (const BoardMask& color : _colors)
+		if ((reach & color).any())
+			cluster |= BoardMask::floodFill(seed, color | _multicolor, getParity());
+	return cluster;
+}
+
+BoardMask BubbleBoard::getAnchorMask() const { return (_occupied & utils::RoofMask) | _floating; }
+
+BoardMask BubbleBoard::findDetached()
+{
+	BoardMask detached;
+	if (_popped.none())
+		return detached;
+
+	const BoardMask anchors = getAnchorMask();
+	BoardMask candidates = _popped.expanded(getParity()) & _anchored;
+	_popped = {};
+
+	while (candidates.any())
+	{
+		BoardMask seed;
+		seed.set(candidates.first());
+
+		BoardMask region = seed;
+		bool anchored = false;
+		for (;;)
+		{
+			if ((region & anchors).any())
+			{
+				anchored = true;
+				break;
+			}
+
+			const BoardMask next = (region.expanded(getParity()) & _anchored) | seed;
+			if (next == region)
+				break;
+			region = next;
+		}
+
+		candidates -= region;
+		if (!anchored)
+		{
+			detached |= region;
+			_anchored -= region;
+		}
+	}
+
+	return detached;
+}
+
+BoardMask BubbleBoard::dropDetached(std::vector<Ref<Bubble>>& dropped)
+{
+	const BoardMask detached = findDetached();
+	detached.forEach([this, &dropped](UInt32 index) { dropped.push_back(release(index)); });
+	return detached;
+}
+
+SweepWalls SweepWalls::from(const BouncingBounds& bounds) { return from(bounds, !bounds.isTopEnabled()); }
+SweepWalls SweepWalls::from(const BouncingBounds& bounds, bool roof)
+{
+	SweepWalls walls;
+	walls.bounds = bounds.getBounds();
+	walls.bounceTop = bounds.isTopEnabled();
+	walls.bounceBottom = bounds.isBottomEnabled();
+	walls.roof = roof;
+	return walls;
+}
+
+
+
+
+BoardSweep BubbleBoard::sweep(const Vec2f& position, const Vec2f& speed, float time, const SweepWalls& walls, SweepPath* path) const
+{
+	BoardSweep result;
+	result.position = position;
+	result.speed = speed;
+	if (path)
+		path->add(position);
+
+	const sf::IntRect& rect = walls.bounds;
+	const float minX = static_cast<float>(rect.left) + Radius;
+	const float maxX = static_cast<float>(rect.left + rect.width) - Radius;
+	const float minY = walls.roof ? _origin.y + Radius : static_cast<float>(rect.top) + Radius;
+	const float maxY = static_cast<float>(rect.top + rect.height) - Radius;
+	const bool top = walls.roof || walls.bounceTop;
+
+	float remaining = time;
+	while (remaining > 0 && (result.speed.x != 0 || result.speed.y != 0))
+	{
+		const Vec2f& pos = result.position;
+		const Vec2f& vel = result.speed;
+
+		/* Next wall along the current segment */
+		float wall = remaining;
+		BounceEdge edge = BounceEdge::None;
+		const auto checkWall = [&wall, &edge](float distance, float velocity, BounceEdge side) {
+			const float t = std::max(0.f, distance / velocity);
+			if (t < wall)
+			{
+				wall = t;
+				edge = side;
+			}
+		};
+
+		if (vel.x < 0)
+			checkWall(minX - pos.x, vel.x, BounceEdge::Left);
+		else if (vel.x > 0)
+			checkWall(maxX - pos.x, vel.x, BounceEdge::Right);
+
+		if (vel.y < 0 && top)
+			checkWall(minY - pos.y, vel.y, BounceEdge::Top);
+		else if (vel.y > 0 && walls.bounceBottom)
+			checkWall(maxY - pos.y, vel.y, BounceEdge::Bottom);
+
+		float hit;
+		BoardCell contact;
+		if (castBubbles(pos, vel, wall, hit, contact))
+		{
+			result.position += vel * hit;
+			result.time += hit;
+			result.hit = true;
+			result.contact = contact;
+			result.snapped = findSnapCell(result.position, &contact, result.snap);
+			if (path)
+				path->add(result.position);
+			return result;
+		}
+
+		result.position += vel * wall;
+		result.time += wall;
+		remaining -= wall;
+		if (path)
+			path->add(result.position);
+
+		switch (edge)
+		{
+			case BounceEdge::None:
+				return result;
+
+			case BounceEdge::Top:
+				if (walls.roof)
+				{
+					result.hit = true;
+					result.roof = true;
+					result.snapped = findSnapCell(result.position, nullptr, result.snap);
+					return result;
+				}
+				result.speed.y *= -1;
+				break;
+
+			case BounceEdge::Bottom:
+				result.speed.y *= -1;
+				break;
+
+			case BounceEdge::Left:
+			case BounceEdge::Right:
+				result.speed.x *= -1;
+				break;
+		}
+
+		if (++result.bounces >= utils::MaxSweepBounces)
+			break;
+	}
+
+	return result;
+}
+
+bool BubbleBoard::findSnapCell(const Vec2f& position, const BoardCell* contact, BoardCell& cell) const
+{
+	BoardCell nearest;
+	if (!pixelToCell(clampToBoard(position), nearest))
+		return false;
+
+	if (!_occupied.test(nearest.row, nearest.column))
+	{
+		cell = nearest;
+		return true;
+	}
+
+	const BoardCell& center = contact ? *contact : nearest;
+	float best = std::numeric_limits<float>::max();
+	bool found = false;
+	forEachNeighbor(center.row, center.column, [this, &position, &cell, &best, &found](Row row, Column column) {
+		if (_occupied.test(row, column))
+			return;
+
+		const Vec2f delta = cellToPixel(row, column) - position;
+		const float distance = delta.x * delta.x + delta.y * delta.y;
+		if (distance < best)
+		{
+			best = distance;
+			cell = { row, column };
+			found = true;
+		}
+	});
+	return found;
+}
+
+bool BubbleBoard::castBubbles(const Vec2f& position, const Vec2f& speed, float maxTime, float& time, BoardCell& contact) const
+{
+	const float speed2 = speed.x * speed.x + speed.y * speed.y;
+	if (speed2 <= 0 || _occupied.none())
+		return false;
+
+	/*
+	 * Walk the segment at steps of one radius. Any bubble within ContactDistance of a point
+	 * of the path is then centered in the nearest cell of some step or in one of its neighbors.
+	 */
+	const float length = std::sqrt(speed2) * maxTime;
+	const UInt32 steps = static_cast<UInt32>(std::ceil(length / Radius)) + 1;
+	const float slack = ContactDistance / std::sqrt(speed2);
+
+	/* Nothing can be touched below the lowest attached bubble */
+	const float reach = cellToPixel(indexToCell(_occupied.last()).row, 0).y + ContactDistance + Radius;
+
+	BoardMask tested;
+	bool found = false;
+	float best = maxTime;
+	for (UInt32 i = 0; i <= steps; i++)
+	{
+		const float t = maxTime * static_cast<float>(i) / static_cast<float>(steps);
+		if (t > best + slack)
+			break;
+
+		const Vec2f point = position + speed * t;
+		if (point.y > reach)
+			continue;
+
+		BoardCell cell;
+		if (!pixelToCell(clampToBoard(point), cell))
+			continue;
+
+		BoardMask around;
+		around.set(cell.row, cell.column);
+		const BoardMask candidates = (around.expanded(getParity()) & _occupied) - tested;
+		tested |= candidates;
+
+		candidates.forEach([this, &position, &speed, speed2, &found, &best, &contact](UInt32 index) {
+			const BoardCell target = indexToCell(index);
+			const Vec2f offset = position - cellToPixel(target.row, target.column);
+			const float b = offset.x * speed.x + offset.y * speed.y;
+			const float c = offset.x * offset.x + offset.y * offset.y - ContactDistance * ContactDistance;
+			if (c <= 0)
+			{
+				if (!found || best > 0)
+				{
+					found = true;
+					best = 0;
+					contact = target;
+				}
+				return;
+			}
+
+			const float discriminant = b * b - speed2 * c;
+			if (b >= 0 || discriminant < 0)
+				return;
+
+			const float hit = (-b - std::sqrt(discriminant)) / speed2;
+			if (hit <= best && (!found || hit < best))
+			{
+				found = true;
+				best = hit;
+				contact = target;
+			}
+		});
+	}
+
+	if (found)
+		time = best;
+	return found;
+}
+
+Vec2f BubbleBoard::clampToBoard(const Vec2f& position) const
+{
+	const Vec2f size = getSize();
+	return {
+		utils::clamp(position.x, _origin.x, _origin.x + size.x - 1),
+		utils::clamp(position.y, _origin.y, _origin.y + size.y - 1)
+	};
+}
+
+Ref<Bubble> BubbleBoard::release(UInt32 index)
+{
+	Ref<Bubble>& cell = _cells[slotOf(index)];
+	Ref<Bubble> bubble = cell;
+	if (bubble)
+	{
+		const BoardCell position = indexToCell(index);
+		_hash ^= keyOf(position.row, position.column, bubble);
+		/* Back to board space, the scroll transform no longer applies once off the board */
+		bubble->setPosition(getScrollTransform().transformPoint(bubble->getPosition()));
+		cell = nullptr;
+		_count--;
+		_version++;
+
+		_occupied.reset(index);
+		_colorless.reset(index);
+		_multicolor.reset(index);
+		_floating.reset(index);
+		_anchored.reset(index);
+		for (UInt8 color = 0; color < BubbleColor::Count; color++)
+		{
+			if (_colors[color].test(index))
+			{
+				_colors[color].reset(index);
+				if (--_colorCounts[color] == 0)
+					_colorsPresent -= bubble->getColor();
+			}
+		}
+	}
+	return bubble;
+}
+
+Vec2f BubbleBoard::cellToPixel(Row row, Column column) const
+{
+	const float shift = isPairRow(row) ? Radius : Radius * 2;
+	return {
+		_origin.x + static_cast<float>(column) * CellWidth + shift,
+		_origin.y + static_cast<float>(row) * RowHeight + Radius
+	};
+}
+
+UInt64 BubbleBoard::keyOf(Row row, Column column, const Ref<Bubble>& bubble) const
+{
+	return _keys.key(row, column, BubbleIdentifier(bubble->getModel()->id, bubble->getColor()).code());
+}
+
+Vec2f BubbleBoard::cellToScrolled(Row row, Column column) const
+{
+	/* Bubbles never move on descend, the scroll transform moves all of them at once */
+	return cellToPixel(row, column) - Vec2f(0, static_cast<float>(_descents) * RowHeight);
+}
+
+bool BubbleBoard::pixelToCell(const Vec2f& position, BoardCell& cell) const
+{
+	const Vec2f local = position - _origin;
+	const Vec2f size = getSize();
+	if (local.x < 0 || local.y < 0 || local.x >= size.x || local.y >= size.y)
+		return false;
+
+	/* The point lies between the centers of two consecutive rows, take the nearest of each */
+	const Int32 upper = static_cast<Int32>(std::floor((local.y - Radius) / RowHeight));
+	float best = std::numeric_limits<float>::max();
+	for (Int32 row = upper; row <= upper + 1; row++)
+	{
+		if (row < 0 || row >= static_cast<Int32>(utils::TotalRows))
+			continue;
+
+		const float shift = isPairRow(static_cast<Row>(row)) ? Radius : Radius * 2;
+		const Int32 lastColumn = static_cast<Int32>(getColumnCount(static_cast<Row>(row))) - 1;
+		const Int32 column = utils::clamp(static_cast<Int32>(std::lround((local.x - shift) / CellWidth)), 0, lastColumn);
+
+		const float dx = local.x - (static_cast<float>(column) * CellWidth + shift);
+		const float dy = local.y - (static_cast<float>(row) * RowHeight + Radius);
+		const float distance = dx * dx + dy * dy;
+		if (distance < best)
+		{
+			best = distance;
+			cell = { static_cast<Row>(row), static_cast<Column>(column) };
+		}
+	}
+	return true;
+}
+
+Vec2f BubbleBoard::getSize() const
+{
+	return {
+		static_cast<float>(utils::styleToColumn(_columns)) * CellWidth,
+		static_cast<float>(utils::TotalRows - 1) * RowHeight + Radius * 2
+	};
+}
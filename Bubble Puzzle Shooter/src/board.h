@@ -0,0 +1,623 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <span>
+
+#include "level.h"
+
+
+struct BoardCell
+{
+	Row row;
+	Column column;
+
+	constexpr bool operator== (const BoardCell&) const = default;
+};
+
+namespace utils
+{
+	constexpr UInt32 BoardCellCount = TotalRows * MaxColumnCount;
+	constexpr UInt32 MaxNeighbors = 6;
+	constexpr UInt8 MaxSweepBounces = 32;
+	constexpr UInt32 ColumnStyleCount = MaxColumnCount - MinColumnCount + 1;
+
+	/* Offsets to the neighbors of a cell that stay inside the columns of its style */
+	struct NeighborOffsets
+	{
+		struct Offset { Int8 row; Int8 column; };
+
+		Offset offsets[MaxNeighbors] = {};
+		UInt8 count = 0;
+	};
+
+	/* [style][row parity][column]. Rows are not checked, only columns */
+	using NeighborTable = std::array<std::array<std::array<NeighborOffsets, MaxColumnCount>, 2>, ColumnStyleCount>;
+
+	/*
+	 * Pair rows hold the full column count and odd rows one less, shifted half a cell
+	 * to the right, so the diagonal neighbors of a cell depend on the parity of its row.
+	 */
+	constexpr NeighborTable makeNeighborTable()
+	{
+		constexpr Int8 pairOffsets[MaxNeighbors][2] = { { 0, -1 }, { 0, 1 }, { -1, -1 }, { -1, 0 }, { 1, -1 }, { 1, 0 } };
+		constexpr Int8 oddOffsets[MaxNeighbors][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { -1, 1 }, { 1, 0 }, { 1, 1 } };
+
+		NeighborTable table{};
+		for (UInt32 style = 0; style < ColumnStyleCount; style++)
+		{
+			const Int32 columns = static_cast<Int32>(MinColumnCount + style);
+			for (UInt32 parity = 0; parity < 2; parity++)
+			{
+				const auto& offsets = parity == 0 ? pairOffsets : oddOffsets;
+				const Int32 ownColumns = parity == 0 ? columns : columns - 1;
+				for (Int32 column = 0; column < ownColumns; column++)
+				{
+					NeighborOffsets& cell = table[style][parity][column];
+					for (UInt32 i = 0; i < MaxNeighbors; i++)
+					{
+						const Int32 targetColumns = offsets[i][0] == 0 ? ownColumns : (parity == 0 ? columns - 1 : columns);
+						const Int32 target = column + offsets[i][1];
+						if (target >= 0 && target < targetColumns)
+							cell.offsets[cell.count++] = { offsets[i][0], offsets[i][1] };
+					}
+				}
+			}
+		}
+		return table;
+	}
+
+	inline constexpr NeighborTable BoardNeighbors = makeNeighborTable();
+
+	constexpr const NeighborOffsets& neighborOffsets(BoardColumnStyle style, Row row, Column column)
+	{
+		return BoardNeighbors[styleToColumn(style) - MinColumnCount][isPairRow(row) ? 0 : 1][column];
+	}
+}
+
+
+
+/*
+ * One bit per board cell with the same row * MaxColumnCount + column index as BubbleBoard,
+ * so every row is a 16-bit lane and a hex neighbor is a fixed shift plus an edge mask.
+ */
+class BoardMask
+{
+public:
+	static constexpr UInt32 WordBits = 64;
+	static constexpr UInt32 WordCount = (utils::BoardCellCount + WordBits - 1) / WordBits;
+
+private:
+	std::array<UInt64, WordCount> _words;
+
+public:
+	constexpr BoardMask() :
+		_words{}
+	{}
+
+	constexpr bool test(UInt32 index) const { return (_words[index / WordBits] >> (index % WordBits)) & 0x1; }
+	constexpr void set(UInt32 index) { _words[index / WordBits] |= UInt64(1) << (index % WordBits); }
+	constexpr void reset(UInt32 index) { _words[index / WordBits] &= ~(UInt64(1) << (index % WordBits)); }
+
+	constexpr bool test(Row row, Column column) const { return test(row * utils::MaxColumnCount + column); }
+	constexpr void set(Row row, Column column) { set(row * utils::MaxColumnCount + column); }
+	constexpr void reset(Row row, Column column) { reset(row * utils::MaxColumnCount + column); }
+
+	constexpr bool any() const
+	{
+		UInt64 bits = 0;
+		for (UInt32 i = 0; i < WordCount; i++)
+			bits |= _words[i];
+		return bits != 0;
+	}
+	constexpr bool none() const { return !any(); }
+
+	constexpr UInt32 count() const
+	{
+		UInt32 bits = 0;
+		for (UInt32 i = 0; i < WordCount; i++)
+			bits += static_cast<UInt32>(std::popcount(_words[i]));
+		return bits;
+	}
+
+	constexpr bool operator== (const BoardMask&) const = default;
+
+	constexpr BoardMask operator| (const BoardMask& right) const { return combine(right, [](UInt64 a, UInt64 b) { return a | b; }); }
+	constexpr BoardMask operator& (const BoardMask& right) const { return combine(right, [](UInt64 a, UInt64 b) { return a & b; }); }
+	constexpr BoardMask operator^ (const BoardMask& right) const { return combine(right, [](UInt64 a, UInt64 b) { return a ^ b; }); }
+	constexpr BoardMask operator- (const BoardMask& right) const { return combine(right, [](UInt64 a, UInt64 b) { return a & ~b; }); }
+
+	constexpr BoardMask& operator|= (const BoardMask& right) { return *this = *this | right; }
+	constexpr BoardMask& operator&= (const BoardMask& right) { return *this = *this & right; }
+	constexpr BoardMask& operator-= (const BoardMask& right) { return *this = *this - right; }
+
+	/* Moves every bit towards higher cell indices. bits < WordBits */
+	constexpr BoardMask shiftedForward(UInt32 bits) const
+	{
+		BoardMask mask;
+		mask._words[0] = _words[0] << bits;
+		for (UInt32 i = 1; i < WordCount; i++)
+			mask._words[i] = (_words[i] << bits) | (_words[i - 1] >> (WordBits - bits));
+		return mask;
+	}
+
+	/* Moves every bit towards lower cell indices. bits < WordBits */
+	constexpr BoardMask shiftedBackward(UInt32 bits) const
+	{
+		BoardMask mask;
+		for (UInt32 i = 0; i < WordCount - 1; i++)
+			mask._words[i] = (_words[i] >> bits) | (_words[i + 1] << (WordBits - bits));
+		mask._words[WordCount - 1] = _words[WordCount - 1] >> bits;
+		return mask;
+	}
+
+	/* Calls action(UInt32 index) for every set cell in index order */
+	template<typename _Func>
+	void forEach(_Func&& action) const
+	{
+		for (UInt32 i = 0; i < WordCount; i++)
+		{
+			UInt64 bits = _words[i];
+			while (bits)
+			{
+				action(i * WordBits + static_cast<UInt32>(std::countr_zero(bits)));
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	/* Index of the lowest set cell, or BoardCellCount if empty */
+	constexpr UInt32 first() const
+	{
+		for (UInt32 i = 0; i < WordCount; i++)
+			if (_words[i])
+				return i * WordBits + static_cast<UInt32>(std::countr_zero(_words[i]));
+		return utils::BoardCellCount;
+	}
+
+	/* Index of the highest set cell, or BoardCellCount if empty */
+	constexpr UInt32 last() const
+	{
+		for (UInt32 i = WordCount; i > 0; i--)
+			if (_words[i - 1])
+				return (i - 1) * WordBits + WordBits - 1 - static_cast<UInt32>(std::countl_zero(_words[i - 1]));
+		return utils::BoardCellCount;
+	}
+
+	/*
+	 * The mask plus the hex neighbors of all its cells. Full and short rows differ on the
+	 * diagonals; with parity 1 the full rows are the odd ones.
+	 */
+	constexpr BoardMask expanded(UInt32 parity = 0) const;
+
+	/*
+	 * Cells of allowed connected to seed through hex neighbors. The seed itself is always included.
+	 * Works on the 16-bit row lanes and only revisits the rows around those that grew in the
+	 * previous pass, so a small cluster costs a few lanes instead of whole board expansions.
+	 */
+	static constexpr BoardMask floodFill(const BoardMask& seed, const BoardMask& allowed, UInt32 parity = 0);
+
+	static constexpr BoardMask rows(bool pair)
+	{
+		BoardMask mask;
+		for (Row row = pair ? 0 : 1; row < utils::TotalRows; row += 2)
+			for (Column column = 0; column < utils::MaxColumnCount; column++)
+				mask.set(row, column);
+		return mask;
+	}
+
+	static constexpr BoardMask row(Row row)
+	{
+		BoardMask mask;
+		for (Column column = 0; column < utils::MaxColumnCount; column++)
+			mask.set(row, column);
+		return mask;
+	}
+
+	static constexpr BoardMask column(Column column)
+	{
+		BoardMask mask;
+		for (Row row = 0; row < utils::TotalRows; row++)
+			mask.set(row, column);
+		return mask;
+	}
+
+	static constexpr BoardMask valid(BoardColumnStyle style, UInt32 parity = 0)
+	{
+		BoardMask mask;
+		for (Row row = 0; row < utils::TotalRows; row++)
+			for (Column column = 0; column < utils::adaptIfIsOdd(row + parity, style); column++)
+				mask.set(row, column);
+		return mask;
+	}
+
+private:
+	static constexpr UInt32 LaneBits = utils::MaxColumnCount;
+	static constexpr UInt32 LanesPerWord = WordBits / LaneBits;
+
+	constexpr UInt16 lane(Row row) const { return static_cast<UInt16>(_words[row / LanesPerWord] >> (row % LanesPerWord * LaneBits)); }
+	constexpr void orLane(Row row, UInt16 bits) { _words[row / LanesPerWord] |= UInt64(bits) << (row % LanesPerWord * LaneBits); }
+
+	template<typename _Func>
+	constexpr BoardMask combine(const BoardMask& right, _Func&& op) const
+	{
+		BoardMask mask;
+		for (UInt32 i = 0; i < WordCount; i++)
+			mask._words[i] = op(_words[i], right._words[i]);
+		return mask;
+	}
+};
+
+namespace utils
+{
+	inline constexpr BoardMask PairRowsMask = BoardMask::rows(true);
+	inline constexpr BoardMask OddRowsMask = BoardMask::rows(false);
+	inline constexpr BoardMask FirstColumnMask = BoardMask::column(0);
+	inline constexpr BoardMask LastColumnMask = BoardMask::column(MaxColumnCount - 1);
+	inline constexpr BoardMask RoofMask = BoardMask::row(0);
+	inline constexpr BoardMask BottomRowMask = BoardMask::row(TotalRows - 1);
+}
+
+constexpr BoardMask BoardMask::expanded(UInt32 parity) const
+{
+	constexpr UInt32 row = utils::MaxColumnCount;
+	const BoardMask pair = *this & (parity ? utils::OddRowsMask : utils::PairRowsMask);
+	const BoardMask odd = *this - pair;
+
+	return *this
+		| (shiftedForward(1) - utils::FirstColumnMask)
+		| (shiftedBackward(1) - utils::LastColumnMask)
+		| shiftedForward(row)
+		| shiftedBackward(row)
+		| (pair.shiftedForward(row - 1) - utils::LastColumnMask)
+		| (pair.shiftedBackward(row + 1) - utils::LastColumnMask)
+		| (odd.shiftedForward(row + 1) - utils::FirstColumnMask)
+		| (odd.shiftedBackward(row - 1) - utils::FirstColumnMask);
+}
+
+constexpr BoardMask BoardMask::floodFill(const BoardMask& seed, const BoardMask& allowed, UInt32 parity)
+{
+	static_assert(LaneBits == 16 && WordBits % LaneBits == 0, "rows must be 16-bit lanes of the words");
+
+	const UInt32 first = seed.first();
+	if (first == utils::BoardCellCount)
+		return seed;
+
+	/* One lane per row, plus an empty row above and below so neighbors need no bounds checks */
+	std::array<UInt16, utils::TotalRows + 2> fill{};
+	Int32 low = static_cast<Int32>(first / LaneBits);
+	Int32 high = static_cast<Int32>(seed.last() / LaneBits);
+	for (Int32 row = low; row <= high; row++)
+		fill[row + 1] = seed.lane(static_cast<Row>(row));
+
+	/* What a row reaches in the rows above and below: its columns plus one diagonal, as in expanded() */
+	const auto vertical = [&fill, parity](Int32 row) -> UInt32 {
+		const UInt32 bits = fill[row + 1];
+		return bits | (((row + parity) & 1) == 0 ? bits >> 1 : bits << 1);
+	};
+
+	/* Rows are updated in place, so growth also flows up the same pass. Stops once no row grows */
+	Int32 top = low, bottom = high;
+	while (low <= high)
+	{
+		const Int32 from = std::max(low - 1, 0);
+		const Int32 to = std::min(high + 1, static_cast<Int32>(utils::TotalRows) - 1);
+		low = utils::TotalRows;
+		high = -1;
+
+		for (Int32 row = from; row <= to; row++)
+		{
+			const UInt32 bits = fill[row + 1];
+			const UInt32 around = bits << 1 | bits >> 1 | vertical(row - 1) | vertical(row + 1);
+			const UInt16 grown = static_cast<UInt16>(bits | (around & allowed.lane(static_cast<Row>(row))));
+			if (grown != bits)
+			{
+				fill[row + 1] = grown;
+				low = std::min(low, row);
+				high = std::max(high, row);
+			}
+		}
+		top = std::min(top, low);
+		bottom = std::max(bottom, high);
+	}
+
+	BoardMask mask;
+	for (Int32 row = top; row <= bottom; row++)
+		mask.orLane(static_cast<Row>(row), fill[row + 1]);
+	return mask;
+}
+
+
+
+/*
+ * Walls for BubbleBoard::sweep. Side walls always reflect. The roof, when enabled, takes
+ * the shot at the first row; otherwise the top reflects only if bounceTop is set.
+ */
+struct SweepWalls
+{
+	sf::IntRect bounds;
+	bool bounceTop = false;
+	bool bounceBottom = false;
+	bool roof = true;
+
+	static SweepWalls from(const BouncingBounds& bounds);
+	static SweepWalls from(const BouncingBounds& bounds, bool roof);
+};
+
+/* Points where a swept bubble started, bounced and stopped */
+struct SweepPath
+{
+	std::array<Vec2f, static_cast<size_t>(utils::MaxSweepBounces) + 2> points;
+	UInt8 count = 0;
+
+	inline void add(const Vec2f& point) { if (count < points.size()) points[count++] = point; }
+};
+
+/*
+ * Zobrist keys of (cell, packed bubble identifier) pairs, derived only from a seed so hashes
+ * are reproducible across runs. The key of a cell is the key of its column rotated left by
+ * its row: moving every row one down rotates the whole hash by one bit instead of rehashing
+ * every bubble.
+ */
+class ZobristKeys
+{
+private:
+	RNG::Seed _seed;
+	std::array<UInt64, utils::MaxColumnCount> _columns;
+	UInt64 _parity;
+
+	static_assert(utils::TotalRows < 64, "row rotations must stay distinct");
+
+public:
+	ZobristKeys(RNG::Seed seed = 0);
+
+	RNG::Seed getSeed() const;
+
+	/* Toggled into the board hash while the rows are flipped, see BubbleBoard::getParity() */
+	UInt64 getParityKey() const;
+
+	/* code is BubbleIdentifier::code() */
+	inline UInt64 key(Row row, Column column, UInt32 code) const
+	{
+		return std::rotl(mix(_columns[column] ^ (static_cast<UInt64>(code) * 0x9e3779b97f4a7c15ULL)), static_cast<int>(row));
+	}
+
+	static constexpr UInt64 mix(UInt64 value)
+	{
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+		return value ^ (value >> 31);
+	}
+};
+
+/* Outcome of moving a bubble through the board for some time, see BubbleBoard::sweep */
+struct BoardSweep
+{
+	Vec2f position;
+	Vec2f speed;
+	float time = 0;
+
+	/* Touched a bubble or the roof. Both cells are only meaningful when hit */
+	bool hit = false;
+	bool roof = false;
+	bool snapped = false;
+	BoardCell contact = {};
+	BoardCell snap = {};
+
+	UInt8 bounces = 0;
+};
+
+
+
+/*
+ * Live board of attached bubbles. Cells are a fixed TotalRows x MaxColumnCount array
+ * of bubble references; row 0 is the roof. Storage is a ring of rows, so descend() only
+ * moves the first row and shifts the masks, which keep the logical row * MaxColumnCount
+ * + column index. Every descent flips which rows are full, see isPairRow().
+ *
+ * cellToPixel() gives bubble centers relative to the board origin. Attached bubbles are
+ * not moved by descents: their own position is set once in a frame that scrolls with the
+ * board, and getScrollTransform() maps it to the board when rendering.
+ */
+class BubbleBoard
+{
+public:
+	static constexpr UInt32 CellCount = utils::BoardCellCount;
+	static constexpr float CellWidth = static_cast<float>(Bubble::HitboxWith);
+	static constexpr float RowHeight = static_cast<float>(Bubble::HitboxHeight);
+	static constexpr float Radius = static_cast<float>(Bubble::Radius);
+
+	/* Center distance at which a moving bubble sticks. A bit under two radii so shots fit through diagonal gaps */
+	static constexpr float ContactDistance = RowHeight;
+
+private:
+	std::array<Ref<Bubble>, CellCount> _cells;
+	BoardColumnStyle _columns;
+	Vec2f _origin;
+	UInt32 _count;
+	UInt32 _version;
+	UInt32 _firstRow;
+	UInt32 _descents;
+
+	ZobristKeys _keys;
+	UInt64 _hash;
+
+	BoardMask _valid;
+	BoardMask _occupied;
+	BoardMask _colorless;
+	BoardMask _multicolor;
+	std::array<BoardMask, BubbleColor::Count> _colors;
+	std::array<UInt16, BubbleColor::Count> _colorCounts;
+	BubbleColor::Mask _colorsPresent;
+
+	/* Cells connected to the roof or to a floating bubble, as of the last check */
+	BoardMask _floating;
+	BoardMask _anchored;
+	BoardMask _popped;
+
+public:
+	BubbleBoard(BoardColumnStyle columns = BoardColumnStyle::Min);
+	~BubbleBoard();
+
+	NON_COPYABLE_MOVABLE(BubbleBoard);
+
+	/* Empties the board and takes the column style and hash seed of the level */
+	void setup(const LevelProperties& props);
+
+	BoardColumnStyle getColumnStyle() const;
+
+	/* Changing the column style empties the board */
+	void setColumnStyle(BoardColumnStyle columns);
+
+	const Vec2f& getOrigin() const;
+	void setOrigin(const Vec2f& origin);
+
+	Column getColumnCount(Row row) const;
+	bool isValidCell(Row row, Column column) const;
+
+	/* Full rows hold every column, short ones one less shifted half a cell */
+	bool isPairRow(Row row) const;
+	UInt32 getParity() const;
+
+	/* Rows descended since the last clear */
+	UInt32 getDescentCount() const;
+
+	/* Moves the positions given to attached bubbles onto the board */
+	sf::Transform getScrollTransform() const;
+
+	UInt32 size() const;
+	bool empty() const;
+
+	/* Changes on every attach, pop, clear or layout change */
+	UInt32 getVersion() const;
+
+	/*
+	 * Zobrist hash of the bubbles and the row parity, kept up to date on every attach,
+	 * removal and descent. Equal boards hash equally under the same keys.
+	 */
+	UInt64 getHash() const;
+	/* Recomputes the hash from every attached bubble, to check the incremental one */
+	UInt64 computeHash() const;
+	bool verifyHash() const;
+
+	const ZobristKeys& getHashKeys() const;
+	/* Rebuilds the keys, e.g. from LevelProperties::getSeed(), and rehashes the board */
+	void setHashSeed(RNG::Seed seed);
+
+	bool isEmpty(Row row, Column column) const;
+	const Ref<Bubble>& getBubble(Row row, Column column) const;
+
+	/* Places the bubble centered in an empty cell. Returns false if the cell is invalid or taken */
+	bool attach(Row row, Column column, const Ref<Bubble>& bubble);
+
+	/* Empties the cell and returns the bubble it held, back in board space. Its neighbors are rechecked by the next findDetached() */
+	Ref<Bubble> pop(Row row, Column column);
+
+	/* Pops every cell of the mask, appending the bubbles to popped in cell order */
+	void pop(const BoardMask& cells, std::vector<Ref<Bubble>>& popped);
+
+	void clear();
+
+	/*
+	 * Moves every row one down and fills the new roof row with row, null meaning empty. The
+	 * bubbles of the last row are pushed out of the board and appended to pushedOut. Empty
+	 * roof cells count as popped, so whatever only hung from the old roof row is reported by
+	 * the next findDetached().
+	 */
+	void descend(std::span<const Ref<Bubble>> row, std::vector<Ref<Bubble>>& pushedOut);
+
+	/* Writes the valid neighbor cells into neighbors. Returns how many */
+	UInt8 getNeighbors(Row row, Column column, BoardCell (&neighbors)[utils::MaxNeighbors]) const;
+
+	/* Calls action(Row, Column) for each valid neighbor cell */
+	template<typename _Func>
+	void forEachNeighbor(Row row, Column column, _Func&& action) const
+	{
+		const utils::NeighborOffsets& offsets = utils::neighborOffsets(_columns, row + getParity(), column);
+		for (UInt8 i = 0; i < offsets.count; i++)
+		{
+			const Row nrow = row + offsets.offsets[i].row;
+			if (nrow < utils::TotalRows)
+				action(nrow, column + offsets.offsets[i].column);
+		}
+	}
+
+	const BoardMask& getValidMask() const;
+	const BoardMask& getOccupiedMask() const;
+	const BoardMask& getColorlessMask() const;
+	const BoardMask& getMulticolorMask() const;
+	const BoardMask& getColorMask(const BubbleColor& color) const;
+
+	/* Attached bubbles of a normal color, kept up to date on every attach and removal */
+	UInt32 getColorCount(const BubbleColor& color) const;
+	/* Colors with at least one attached bubble */
+	BubbleColor::Mask getPresentColors() const;
+
+	/*
+	 * Cells that match the color of the bubble at (row, column) and are connected to it,
+	 * following Bubble::colorMatch: multicolor bubbles join any color and colorless ones
+	 * match nothing. Empty if the cell is empty.
+	 */
+	BoardMask findCluster(Row row, Column column) const;
+
+	/* Roof row cells and floating bubbles, which hold up everything connected to them */
+	BoardMask getAnchorMask() const;
+
+	/*
+	 * Cells left hanging by the pops since the last call. Only the regions next to the
+	 * popped cells are walked, and each stops as soon as it reaches an anchor.
+	 */
+	BoardMask findDetached();
+
+	/* Removes every detached cluster at once. Returns their cells and appends their bubbles to dropped */
+	BoardMask dropDetached(std::vector<Ref<Bubble>>& dropped);
+
+	Vec2f cellToPixel(Row row, Column column) const;
+
+	/* Nearest cell center to position. Returns false if position lies outside the board */
+	bool pixelToCell(const Vec2f& position, BoardCell& cell) const;
+
+	Vec2f getSize() const;
+
+	/*
+	 * Moves a bubble centered at position with constant speed for time, reflecting on the walls.
+	 * Stops at the first contact with an attached bubble or the roof and picks the empty cell to
+	 * attach to. Only the cells along the path are tested. If path is given, the start, every
+	 * bounce and the final position are appended to it.
+	 */
+	BoardSweep sweep(const Vec2f& position, const Vec2f& speed, float time, const SweepWalls& walls, SweepPath* path = nullptr) const;
+
+	/* Same walls as BouncingBounds::check, with the roof wherever the top does not bounce */
+	inline BoardSweep sweep(const Vec2f& position, const Vec2f& speed, float time, const BouncingBounds& bounds) const
+	{
+		return sweep(position, speed, time, SweepWalls::from(bounds));
+	}
+
+	/* Empty cell nearest to position next to contact, or to position itself */
+	bool findSnapCell(const Vec2f& position, const BoardCell* contact, BoardCell& cell) const;
+
+private:
+	/* Earliest contact with an attached bubble over [0, maxTime] */
+	bool castBubbles(const Vec2f& position, const Vec2f& speed, float maxTime, float& time, BoardCell& contact) const;
+
+	Vec2f clampToBoard(const Vec2f& position) const;
+
+	Ref<Bubble> release(UInt32 index);
+
+	UInt64 keyOf(Row row, Column column, const Ref<Bubble>& bubble) const;
+
+	/* Position given to the bubble attached at (row, column), before the scroll transform */
+	Vec2f cellToScrolled(Row row, Column column) const;
+
+	/* Storage slot of a logical cell index */
+	inline UInt32 slotOf(UInt32 index) const
+	{
+		const UInt32 row = index / utils::MaxColumnCount + _firstRow;
+		return (row < utils::TotalRows ? row : row - utils::TotalRows) * utils::MaxColumnCount + index % utils::MaxColumnCount;
+	}
+
+	static constexpr UInt32 cellIndex(Row row, Column column) { return row * utils::MaxColumnCount + column; }
+	static constexpr BoardCell indexToCell(UInt32 index) { return { index / utils::MaxColumnCount, index % utils::MaxColumnCount }; }
+
+	inline const Ref<Bubble>& operator[] (const BoardCell& cell) const { return getBubble(cell.row, cell.column); }
+};
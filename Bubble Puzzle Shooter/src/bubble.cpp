@@ -1,5 +1,8 @@
 #include "bubble.h"
 
+#include <bit>
+#include <limits>
+
 #include "props.h"
 
 #define BUBBLECOLOR_CODE_RED (0x1 << 0)
@@ -40,6 +43,8 @@ std::string BubbleColor::name() const
 	return "<invalid-color>";
 }
 
+UInt8 BubbleColor::index() const { return _code ? static_cast<UInt8>(std::countr_zero(_code)) : Count; }
+
 bool BubbleColor::isInvalid() const { return !(*this); }
 bool BubbleColor::isRandom() const { return !(*this); }
 
@@ -53,8 +58,8 @@ BubbleColor::Mask operator+ (const BubbleColor& left, BubbleColor::Mask right) {
 BubbleColor::Mask operator- (BubbleColor::Mask left, const BubbleColor& right) { return left & ~right._code; }
 BubbleColor::Mask operator- (const BubbleColor& left, BubbleColor::Mask right) { return right & ~left._code; }
 
-bool operator& (BubbleColor::Mask left, const BubbleColor& right) { return (left & right._code) == left; }
-bool operator& (const BubbleColor& left, BubbleColor::Mask right) { return (right & left._code) == right; }
+bool operator& (BubbleColor::Mask left, const BubbleColor& right) { return left & right._code; }
+bool operator& (const BubbleColor& left, BubbleColor::Mask right) { return right & left._code; }
 
 BubbleColor::Mask& operator+= (BubbleColor::Mask& left, const BubbleColor& right) { return left = left + right; }
 BubbleColor::Mask& operator-= (BubbleColor::Mask& left, const BubbleColor& right) { return left = left - right; }
@@ -87,6 +92,23 @@ BubbleColor BubbleColor::defaultColor() { return BubbleColor::Blue; }
 
 
 
+BubbleBatch::BubbleBatch(std::span<Bubble* const> bubbles, std::span<const BubbleColor> colors, bool editorMode) :
+	_bubbles{ bubbles },
+	_colors{ colors },
+	_editorMode{ editorMode }
+{}
+BubbleBatch::~BubbleBatch() {}
+
+size_t BubbleBatch::size() const { return _bubbles.size(); }
+
+Bubble* BubbleBatch::getBubble(size_t index) const { return _bubbles[index]; }
+const BubbleColor& BubbleBatch::getColor(size_t index) const { return _colors[index]; }
+
+bool BubbleBatch::isEditorMode() const { return _editorMode; }
+
+
+
+
 bool operator== (const BubbleModel& left, const BubbleModel& right) { return left.name == right.name; }
 bool operator!= (const BubbleModel& left, const BubbleModel& right) { return left.name != right.name; }
 
@@ -105,6 +127,10 @@ void BouncingBounds::setBounds(const sf::IntRect& bounds) { _bounds = bounds; }
 void BouncingBounds::setTopEnabled(bool flag) { _top = flag; }
 void BouncingBounds::setBottomEnabled(bool flag) { _bottom = flag; }
 
+const sf::IntRect& BouncingBounds::getBounds() const { return _bounds; }
+bool BouncingBounds::isTopEnabled() const { return _top; }
+bool BouncingBounds::isBottomEnabled() const { return _bottom; }
+
 BounceEdge BouncingBounds::check()
 {
 	Vec2f pos = _bubble.getPosition();
@@ -147,6 +173,137 @@ BounceEdge BouncingBounds::check()
 
 
 
+BubbleLocals::BubbleLocals(UInt8 ints, UInt8 floats, UInt8 strings) :
+	_inline{},
+	_ints{ ints },
+	_floats{ floats },
+	_strings{ strings }
+{
+	if (!isInline())
+		_heap = new UInt32[size()]{};
+}
+BubbleLocals::BubbleLocals(const BubbleLocals& locals) :
+	_inline{},
+	_ints{ 0 },
+	_floats{ 0 },
+	_strings{ 0 }
+{
+	_copy(locals);
+}
+BubbleLocals::BubbleLocals(BubbleLocals&& locals) noexcept :
+	_inline{},
+	_ints{ 0 },
+	_floats{ 0 },
+	_strings{ 0 }
+{
+	_move(std::move(locals));
+}
+BubbleLocals::~BubbleLocals() { _del(); }
+
+BubbleLocals& BubbleLocals::operator= (const BubbleLocals& locals)
+{
+	if (this != &locals)
+	{
+		_del();
+		_copy(locals);
+	}
+	return *this;
+}
+BubbleLocals& BubbleLocals::operator= (BubbleLocals&& locals) noexcept
+{
+	if (this != &locals)
+	{
+		_del();
+		_move(std::move(locals));
+	}
+	return *this;
+}
+
+UInt8 BubbleLocals::getIntCount() const { return _ints; }
+UInt8 BubbleLocals::getFloatCount() const { return _floats; }
+UInt8 BubbleLocals::getStringCount() const { return _strings; }
+
+Int32 BubbleLocals::getInt(UInt8 index) const { return static_cast<Int32>(slots()[index]); }
+float BubbleLocals::getFloat(UInt8 index) const { return std::bit_cast<float>(slots()[_ints + index]); }
+const std::string& BubbleLocals::getString(UInt8 index) const { return interned(slots()[_ints + _floats + index]); }
+
+void BubbleLocals::setInt(UInt8 index, Int32 value) { slots()[index] = static_cast<UInt32>(value); }
+void BubbleLocals::setFloat(UInt8 index, float value) { slots()[_ints + index] = std::bit_cast<UInt32>(value); }
+void BubbleLocals::setString(UInt8 index, const std::string& value) { slots()[_ints + _floats + index] = intern(value); }
+
+UInt32 BubbleLocals::size() const { return static_cast<UInt32>(_ints) + _floats + _strings; }
+bool BubbleLocals::isInline() const { return size() <= InlineSlots; }
+
+UInt32* BubbleLocals::slots() { return isInline() ? _inline : _heap; }
+const UInt32* BubbleLocals::slots() const { return isInline() ? _inline : _heap; }
+
+void BubbleLocals::_copy(const BubbleLocals& locals)
+{
+	_ints = locals._ints;
+	_floats = locals._floats;
+	_strings = locals._strings;
+	if (!isInline())
+		_heap = new UInt32[size()];
+	std::copy(locals.slots(), locals.slots() + size(), slots());
+}
+void BubbleLocals::_move(BubbleLocals&& locals) noexcept
+{
+	_ints = locals._ints;
+	_floats = locals._floats;
+	_strings = locals._strings;
+	if (isInline())
+		std::copy(locals._inline, locals._inline + size(), _inline);
+	else _heap = locals._heap;
+
+	locals._ints = 0;
+	locals._floats = 0;
+	locals._strings = 0;
+}
+void BubbleLocals::_del()
+{
+	if (!isInline())
+		delete[] _heap;
+	_ints = 0;
+	_floats = 0;
+	_strings = 0;
+}
+
+static std::vector<std::string>& internedStrings()
+{
+	static std::vector<std::string> strings{ std::string{} };
+	return strings;
+}
+static std::unordered_map<std::string, UInt32>& internedIds()
+{
+	static std::unordered_map<std::string, UInt32> ids;
+	return ids;
+}
+
+UInt32 BubbleLocals::intern(const std::string& str)
+{
+	if (str.empty())
+		return 0;
+
+	auto& ids = internedIds();
+	auto it = ids.find(str);
+	if (it != ids.end())
+		return it->second;
+
+	auto& strings = internedStrings();
+	UInt32 id = static_cast<UInt32>(strings.size());
+	strings.push_back(str);
+	ids[str] = id;
+	return id;
+}
+const std::string& BubbleLocals::interned(UInt32 id)
+{
+	const auto& strings = internedStrings();
+	return id < strings.size() ? strings[id] : utils::EmptyString;
+}
+
+
+
+
 Bubble::Bubble(const Ref<BubbleModel>& model, TextureManager& texs) :
 	_model{ model },
 	_exploited{ false },
@@ -158,9 +315,7 @@ Bubble::Bubble(const Ref<BubbleModel>& model, TextureManager& texs) :
 	_color{ BubbleColor::defaultColor() },
 	_sprite{},
 	_bounce{ *this },
-	_localInts(model->localInts, 0),
-	_localFloats(model->localFloats, 0.f),
-	_localStrings(model->localStrings, "")
+	_locals{ model->localInts, model->localFloats, model->localStrings }
 {}
 
 Bubble::~Bubble() {}
@@ -211,6 +366,9 @@ bool Bubble::colorMatch(const Ref<Bubble>& other) const
 AnimatedSprite* Bubble::getSprite() { return &_sprite; }
 const AnimatedSprite* Bubble::getSprite() const { return &_sprite; }
 
+BouncingBounds& Bubble::getBouncingBounds() { return _bounce; }
+const BouncingBounds& Bubble::getBouncingBounds() const { return _bounce; }
+
 
 /* Model functions */
 Int8 Bubble::getResistence() const { return _model->resistence; }
@@ -220,86 +378,273 @@ bool Bubble::destroyInBottom() const { return _model->destroyInBottom; }
 bool Bubble::requireDestroyToClear() const { return _model->requireDestroyToClear; }
 float Bubble::getPointsOfTurnsToDown() const { return _model->pointsOfTurnsToDown; }
 
-Int32 Bubble::getLocalInt(UInt8 index) const { return _localInts[index]; }
-float Bubble::getLocalFloat(UInt8 index) const { return _localFloats[index]; }
-std::string Bubble::getLocalString(UInt8 index) const { return _localStrings[index]; }
+Int32 Bubble::getLocalInt(UInt8 index) const { return _locals.getInt(index); }
+float Bubble::getLocalFloat(UInt8 index) const { return _locals.getFloat(index); }
+std::string Bubble::getLocalString(UInt8 index) const { return _locals.getString(index); }
 
-void Bubble::setLocalInt(UInt8 index, Int32 value) { _localInts[index] = value; }
-void Bubble::setLocalFloat(UInt8 index, const float& value) { _localFloats[index] = value; }
-void Bubble::setLocalString(UInt8 index, const std::string& value) { _localStrings[index] = value; }
+void Bubble::setLocalInt(UInt8 index, Int32 value) { _locals.setInt(index, value); }
+void Bubble::setLocalFloat(UInt8 index, const float& value) { _locals.setFloat(index, value); }
+void Bubble::setLocalString(UInt8 index, const std::string& value) { _locals.setString(index, value); }
 
 void Bubble::copyLocalInts(const std::vector<UInt32>& locals)
 {
-	size_t len = static_cast<size_t>(_model->localInts);
-	if (locals.empty() || len < 1)
+	UInt8 len = _locals.getIntCount();
+	for (UInt8 i = 0; i < len; i++)
+		_locals.setInt(i, i < locals.size() ? static_cast<Int32>(locals[i]) : 0);
+}
+void Bubble::copyLocalFloats(const std::vector<float>& locals)
+{
+	UInt8 len = _locals.getFloatCount();
+	for (UInt8 i = 0; i < len; i++)
+		_locals.setFloat(i, i < locals.size() ? locals[i] : 0.f);
+}
+void Bubble::copyLocalStrings(const std::vector<std::string>& locals)
+{
+	UInt8 len = _locals.getStringCount();
+	for (UInt8 i = 0; i < len; i++)
+		_locals.setString(i, i < locals.size() ? locals[i] : utils::EmptyString);
+}
+
+
+
+
+
+BubbleKinematics::BubbleKinematics() :
+	_bubbles{},
+	_px{}, _py{},
+	_vx{}, _vy{},
+	_ax{}, _ay{},
+	_minX{}, _maxX{}, _minY{}, _maxY{},
+	_edges{}
+{}
+BubbleKinematics::~BubbleKinematics() {}
+
+size_t BubbleKinematics::add(const Ref<Bubble>& bubble)
+{
+	if (!bubble)
+		return npos;
+
+	const Vec2f pos = bubble->getPosition();
+	const Vec2f speed = bubble->getSpeed();
+	const Vec2f acceleration = bubble->getAcceleration();
+	const BouncingBounds& bounce = bubble->getBouncingBounds();
+	const sf::IntRect& bounds = bounce.getBounds();
+	constexpr float radius = static_cast<float>(Bubble::Radius);
+	constexpr float unbounded = std::numeric_limits<float>::infinity();
+
+	_bubbles.push_back(bubble);
+	_px.push_back(pos.x);
+	_py.push_back(pos.y);
+	_vx.push_back(speed.x);
+	_vy.push_back(speed.y);
+	_ax.push_back(acceleration.x);
+	_ay.push_back(acceleration.y);
+	_minX.push_back(static_cast<float>(bounds.left) + radius);
+	_maxX.push_back(static_cast<float>(bounds.left + bounds.width) - radius);
+	_minY.push_back(bounce.isTopEnabled() ? static_cast<float>(bounds.top) + radius : -unbounded);
+	_maxY.push_back(bounce.isBottomEnabled() ? static_cast<float>(bounds.top + bounds.height) - radius : unbounded);
+	_edges.push_back(BounceEdge::None);
+
+	return _bubbles.size() - 1;
+}
+
+size_t BubbleKinematics::find(const Ref<Bubble>& bubble) const
+{
+	for (size_t i = 0; i < _bubbles.size(); i++)
+		if (_bubbles[i] == bubble)
+			return i;
+	return npos;
+}
+
+Ref<Bubble> BubbleKinematics::release(size_t index)
+{
+	Ref<Bubble> bubble = _bubbles[index];
+	if (bubble)
 	{
-		_localInts.clear();
-		return;
+		bubble->setPosition(_px[index], _py[index]);
+		bubble->setSpeed({ _vx[index], _vy[index] });
+		bubble->setAcceleration({ _ax[index], _ay[index] });
 	}
-
-	size_t max = std::min(len, locals.size());
-	_localInts.resize(max);
-	std::copy(locals.begin(), locals.end(), _localInts.begin());
+	remove(index);
+	return bubble;
 }
-void Bubble::copyLocalFloats(const std::vector<float>& locals)
+
+void BubbleKinematics::remove(size_t index)
 {
-	size_t len = static_cast<size_t>(_model->localFloats);
-	if (locals.empty() || len < 1)
+	const size_t last = _bubbles.size() - 1;
+	if (index != last)
 	{
-		_localFloats.clear();
-		return;
+		_bubbles[index] = _bubbles[last];
+		_px[index] = _px[last];
+		_py[index] = _py[last];
+		_vx[index] = _vx[last];
+		_vy[index] = _vy[last];
+		_ax[index] = _ax[last];
+		_ay[index] = _ay[last];
+		_minX[index] = _minX[last];
+		_maxX[index] = _maxX[last];
+		_minY[index] = _minY[last];
+		_maxY[index] = _maxY[last];
+		_edges[index] = _edges[last];
 	}
 
-	size_t max = std::min(len, locals.size());
-	_localFloats.resize(max);
-	std::copy(locals.begin(), locals.end(), _localFloats.begin());
+	_bubbles.pop_back();
+	_px.pop_back();
+	_py.pop_back();
+	_vx.pop_back();
+	_vy.pop_back();
+	_ax.pop_back();
+	_ay.pop_back();
+	_minX.pop_back();
+	_maxX.pop_back();
+	_minY.pop_back();
+	_maxY.pop_back();
+	_edges.pop_back();
 }
-void Bubble::copyLocalStrings(const std::vector<std::string>& locals)
+
+void BubbleKinematics::clear()
+{
+	_bubbles.clear();
+	_px.clear();
+	_py.clear();
+	_vx.clear();
+	_vy.clear();
+	_ax.clear();
+	_ay.clear();
+	_minX.clear();
+	_maxX.clear();
+	_minY.clear();
+	_maxY.clear();
+	_edges.clear();
+}
+
+void BubbleKinematics::reserve(size_t count)
+{
+	_bubbles.reserve(count);
+	_px.reserve(count);
+	_py.reserve(count);
+	_vx.reserve(count);
+	_vy.reserve(count);
+	_ax.reserve(count);
+	_ay.reserve(count);
+	_minX.reserve(count);
+	_maxX.reserve(count);
+	_minY.reserve(count);
+	_maxY.reserve(count);
+	_edges.reserve(count);
+}
+
+void BubbleKinematics::step(float delta)
 {
-	size_t len = static_cast<size_t>(_model->localStrings);
-	if (locals.empty() || len < 1)
+	const size_t count = _bubbles.size();
+	float* const px = _px.data();
+	float* const py = _py.data();
+	float* const vx = _vx.data();
+	float* const vy = _vy.data();
+	const float* const ax = _ax.data();
+	const float* const ay = _ay.data();
+	const float* const minX = _minX.data();
+	const float* const maxX = _maxX.data();
+	const float* const minY = _minY.data();
+	const float* const maxY = _maxY.data();
+	BounceEdge* const edges = _edges.data();
+
+	/* Same edges and priorities as BouncingBounds::check, but both axes are reflected in a corner */
+	for (size_t i = 0; i < count; i++)
 	{
-		_localStrings.clear();
-		return;
+		const float sx = vx[i] + ax[i] * delta;
+		const float sy = vy[i] + ay[i] * delta;
+		const float x = px[i] + sx * delta;
+		const float y = py[i] + sy * delta;
+
+		const bool top = y <= minY[i];
+		const bool bottom = !top && y >= maxY[i];
+		const bool left = x <= minX[i];
+		const bool right = !left && x >= maxX[i];
+
+		px[i] = left ? minX[i] : (right ? maxX[i] : x);
+		py[i] = top ? minY[i] : (bottom ? maxY[i] : y);
+		vx[i] = (left || right) ? -sx : sx;
+		vy[i] = (top || bottom) ? -sy : sy;
+
+		edges[i] = top ? BounceEdge::Top
+			: bottom ? BounceEdge::Bottom
+			: left ? BounceEdge::Left
+			: right ? BounceEdge::Right
+			: BounceEdge::None;
 	}
+}
+
+size_t BubbleKinematics::size() const { return _bubbles.size(); }
+bool BubbleKinematics::empty() const { return _bubbles.empty(); }
+
+const Ref<Bubble>& BubbleKinematics::getBubble(size_t index) const { return _bubbles[index]; }
+Vec2f BubbleKinematics::getPosition(size_t index) const { return { _px[index], _py[index] }; }
+Vec2f BubbleKinematics::getSpeed(size_t index) const { return { _vx[index], _vy[index] }; }
+Vec2f BubbleKinematics::getAcceleration(size_t index) const { return { _ax[index], _ay[index] }; }
+BounceEdge BubbleKinematics::getLastBounce(size_t index) const { return _edges[index]; }
 
-	size_t max = std::min(len, locals.size());
-	_localStrings.resize(max);
-	std::copy(locals.begin(), locals.end(), _localStrings.begin());
+std::span<const float> BubbleKinematics::getPositionsX() const { return _px; }
+std::span<const float> BubbleKinematics::getPositionsY() const { return _py; }
+
+void BubbleKinematics::setSpeed(size_t index, const Vec2f& speed)
+{
+	_vx[index] = speed.x;
+	_vy[index] = speed.y;
+}
+void BubbleKinematics::setAcceleration(size_t index, const Vec2f& acceleration)
+{
+	_ax[index] = acceleration.x;
+	_ay[index] = acceleration.y;
 }
 
 
 
 
 
+static_assert(sizeof(BubbleIdentifier) == sizeof(UInt32));
+
 BubbleIdentifier::BubbleIdentifier() :
-	_model{},
-	_color{ BubbleColor::defaultColor() }
+	BubbleIdentifier{ ModelId(0), BubbleColor::defaultColor() }
+{}
+BubbleIdentifier::BubbleIdentifier(ModelId model, const BubbleColor& color) :
+	_code{ (static_cast<UInt32>(model) << 8) | color.code() }
 {}
 BubbleIdentifier::BubbleIdentifier(const std::string& model, const BubbleColor& color) :
-	_model{ model },
-	_color{ color }
+	BubbleIdentifier{ BubbleModelManager::internModel(model), color }
 {}
 BubbleIdentifier::~BubbleIdentifier() {}
 
-BubbleIdentifier::operator bool() const { return !_model.empty(); }
-bool operator! (const BubbleIdentifier & right) { return right._model.empty(); }
+BubbleIdentifier::operator bool() const { return modelId() != 0; }
+bool operator! (const BubbleIdentifier & right) { return right.modelId() == 0; }
+
+bool BubbleIdentifier::isInvalid() const { return modelId() == 0; }
 
-bool BubbleIdentifier::isInvalid() const { return _model.empty(); }
+const std::string& BubbleIdentifier::model() const { return BubbleModelManager::getModelName(modelId()); }
+void BubbleIdentifier::model(const std::string& model) { modelId(BubbleModelManager::internModel(model)); }
 
-const std::string& BubbleIdentifier::model() const { return _model; }
-void BubbleIdentifier::model(const std::string& model) { _model = model; }
+ModelId BubbleIdentifier::modelId() const { return static_cast<ModelId>(_code >> 8); }
+void BubbleIdentifier::modelId(ModelId model) { _code = (static_cast<UInt32>(model) << 8) | (_code & 0xff); }
 
-const BubbleColor& BubbleIdentifier::color() const { return _color; }
-void BubbleIdentifier::color(const BubbleColor& color) { _color = color; }
+BubbleColor BubbleIdentifier::color() const { return { static_cast<UInt8>(_code & 0xff) }; }
+void BubbleIdentifier::color(const BubbleColor& color) { _code = (_code & ~UInt32(0xff)) | color.code(); }
+
+UInt32 BubbleIdentifier::code() const { return _code; }
 
 Ref<Bubble> BubbleIdentifier::createBubble(BubbleHeap& heap, TextureManager& textures, bool editorMode) const
 {
-	return heap.create(_model, textures, editorMode, _color);
+	return heap.create(*this, textures, editorMode);
 }
 
 BubbleIdentifier BubbleIdentifier::invalid() { return {}; }
 
+BubbleIdentifier BubbleIdentifier::fromCode(UInt32 code)
+{
+	BubbleIdentifier id;
+	id._code = code;
+	return id;
+}
+
 
 
 
@@ -307,30 +652,65 @@ BubbleIdentifier BubbleIdentifier::invalid() { return {}; }
 
 BubbleModelManager::BubbleModelManager() :
 	Manager{ nullptr },
-	_defaultModel{}
+	_defaultModel{ 0 },
+	_ids{},
+	_names(1),
+	_models(1)
 {}
 BubbleModelManager::~BubbleModelManager() {}
 
 Ref<BubbleModel> BubbleModelManager::createModel(const std::string& name)
 {
 	auto model = Instance.create<BubbleModel>(name);
+	if (!model)
+		return nullptr;
+
+	const ModelId id = internModel(name);
 	model->name = name;
+	model->id = id;
+	Instance._models[id] = model;
 	return model;
 }
-Ref<BubbleModel> BubbleModelManager::getModel(const std::string& name)
+Ref<BubbleModel> BubbleModelManager::getModel(const std::string& name) { return getModel(findModelId(name)); }
+Ref<BubbleModel> BubbleModelManager::getModel(ModelId id)
 {
-	auto model = Instance.get(name);
-	if (!model)
-		return getDefaultModel();
-	return model;
+	if (id < Instance._models.size() && Instance._models[id])
+		return Instance._models[id];
+	return getDefaultModel();
 }
 bool BubbleModelManager::hasModel(const std::string& name) { return Instance.has(name); }
+bool BubbleModelManager::hasModel(ModelId id) { return id < Instance._models.size() && Instance._models[id]; }
 
 Ref<BubbleModel> BubbleModelManager::getDefaultModel()
 {
-	if (Instance._defaultModel.empty())
-		Instance._defaultModel = Instance.loadDefaultModel();
-	return Instance.get(Instance._defaultModel);
+	if (!Instance._defaultModel)
+		Instance._defaultModel = internModel(Instance.loadDefaultModel());
+	return Instance._models[Instance._defaultModel];
+}
+
+ModelId BubbleModelManager::internModel(const std::string& name)
+{
+	if (name.empty())
+		return 0;
+
+	auto it = Instance._ids.find(name);
+	if (it != Instance._ids.end())
+		return it->second;
+
+	const ModelId id = static_cast<ModelId>(Instance._names.size());
+	Instance._ids.emplace(name, id);
+	Instance._names.push_back(name);
+	Instance._models.push_back(nullptr);
+	return id;
+}
+ModelId BubbleModelManager::findModelId(const std::string& name)
+{
+	auto it = Instance._ids.find(name);
+	return it == Instance._ids.end() ? 0 : it->second;
+}
+const std::string& BubbleModelManager::getModelName(ModelId id)
+{
+	return id < Instance._names.size() ? Instance._names[id] : utils::EmptyString;
 }
 
 std::string BubbleModelManager::loadDefaultModel() { return Props::getString("default_bubble_model", ""); }
@@ -344,13 +724,24 @@ BubbleModelManager BubbleModelManager::Instance{};
 
 
 BubbleHeap::BubbleHeap() :
-	MemoryAllocator{}
+	MemoryAllocator{},
+	_lastBatch{}
 {}
 BubbleHeap::~BubbleHeap() {}
 
 Ref<Bubble> BubbleHeap::create(const std::string& modelName, TextureManager& textures, bool editorMode, const BubbleColor& color)
 {
-	auto model = BubbleModelManager::getModel(modelName);
+	return create(BubbleModelManager::getModel(modelName), textures, editorMode, color);
+}
+Ref<Bubble> BubbleHeap::create(const BubbleIdentifier& identifier, TextureManager& textures, bool editorMode)
+{
+	if (!identifier)
+		return nullptr;
+
+	return create(BubbleModelManager::getModel(identifier.modelId()), textures, editorMode, identifier.color());
+}
+Ref<Bubble> BubbleHeap::create(const Ref<BubbleModel>& model, TextureManager& textures, bool editorMode, const BubbleColor& color)
+{
 	if (!model)
 		return nullptr;
 
@@ -359,18 +750,79 @@ Ref<Bubble> BubbleHeap::create(const std::string& modelName, TextureManager& tex
 
 	return bubble;
 }
-Ref<Bubble> BubbleHeap::create(const BubbleIdentifier& identifier, TextureManager& textures, bool editorMode)
-{
-	if (!identifier)
-		return nullptr;
-
-	return create(identifier.model(), textures, editorMode, identifier.color());
-}
 void BubbleHeap::destroy(const Ref<Bubble>& bub)
 {
 	free(bub);
 }
 
+std::vector<Ref<Bubble>> BubbleHeap::createBatch(std::span<const BubbleIdentifier> identifiers, TextureManager& textures, bool editorMode)
+{
+	sf::Clock clock;
+	std::vector<Ref<Bubble>> bubbles(identifiers.size());
+
+	/* Stable, so every group keeps the order of the identifiers */
+	std::vector<UInt32> order;
+	order.reserve(identifiers.size());
+	for (UInt32 i = 0; i < identifiers.size(); i++)
+		if (identifiers[i])
+			order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&identifiers](UInt32 left, UInt32 right) {
+		return identifiers[left].modelId() < identifiers[right].modelId();
+	});
+
+	/* Reserving sets the capacity, so count the bubbles already alive */
+	MemoryAllocator::reserve<Bubble>(countOfType<Bubble>() + order.size());
+
+	std::vector<Bubble*> group;
+	std::vector<BubbleColor> colors;
+	UInt32 created = 0;
+	UInt32 groups = 0;
+	for (size_t first = 0, last = 0; first < order.size(); first = last)
+	{
+		const ModelId id = identifiers[order[first]].modelId();
+		while (last < order.size() && identifiers[order[last]].modelId() == id)
+			last++;
+
+		/* Only null when not even the default model could be loaded */
+		const Ref<BubbleModel> model = BubbleModelManager::getModel(id);
+		if (!model)
+			continue;
+
+		group.clear();
+		colors.clear();
+		for (size_t i = first; i < last; i++)
+		{
+			Ref<Bubble>& bubble = bubbles[order[i]];
+			bubble = alloc<Bubble>(model, textures);
+			group.push_back(&bubble);
+			colors.push_back(identifiers[order[i]].color());
+		}
+
+		if (model->initBatch)
+			model->initBatch(BubbleBatch{ group, colors, editorMode });
+		else for (size_t i = 0; i < group.size(); i++)
+			model->init(group[i], colors[i], editorMode);
+		created += static_cast<UInt32>(group.size());
+		groups++;
+	}
+
+	_lastBatch.bubbles = created;
+	_lastBatch.groups = groups;
+	_lastBatch.elapsed = clock.getElapsedTime();
+	return bubbles;
+}
+
+const BubbleHeap::BatchStats& BubbleHeap::getLastBatchStats() const { return _lastBatch; }
+
+bool BubbleHeap::isArenaMode() const { return MemoryAllocator::isArenaMode(); }
+void BubbleHeap::setArenaMode(bool enabled) { MemoryAllocator::setArenaMode(enabled); }
+
+void BubbleHeap::reserve(size_t bubbles) { MemoryAllocator::reserve<Bubble>(bubbles); }
+void BubbleHeap::reset() { clear(); }
+
+size_t BubbleHeap::getHighWaterMark() const { return highWaterMark(); }
+size_t BubbleHeap::getHighWaterBytes() const { return highWaterBytes(); }
+
 
 
 
@@ -391,6 +843,7 @@ UInt16 RandomBubbleModelSelector::getModelScore(const std::string& model) const
 	auto it = _models.find(model);
 	return it == _models.end() ? 0U : it->second;
 }
+const std::map<std::string, UInt16>& RandomBubbleModelSelector::getModelScores() const { return _models; }
 
 Ref<BubbleModel> RandomBubbleModelSelector::selectModel(RNG& rand) const
 {
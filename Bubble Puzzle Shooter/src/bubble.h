@@ -1,11 +1,18 @@
 #pragma once
 
+#include <span>
+#include <unordered_map>
+
 #include "assets.h"
 #include "game_object.h"
 
 
 class Bubble;
 class BubbleHeap;
+class BubbleIdentifier;
+
+/* Dense index of a bubble model name, assigned by BubbleModelManager. 0 is no model */
+typedef UInt16 ModelId;
 
 enum class BubbleColorType
 {
@@ -50,9 +57,14 @@ public:
 	UInt8 code() const;
 	std::string name() const;
 
+	/* Position of the color in all(), or Count if invalid */
+	UInt8 index() const;
+
 public:
 	typedef UInt8 Mask;
 
+	static constexpr UInt8 Count = 8;
+
 	Mask addToMask(Mask mask) const;
 	Mask removeFromMask(Mask mask);
 	bool hasInMask(Mask mask) const;
@@ -69,6 +81,8 @@ public:
 private:
 	BubbleColor(UInt8 code);
 
+	friend class BubbleIdentifier;
+
 public:
 	static const BubbleColor Red;
 	static const BubbleColor Orange;
@@ -89,10 +103,34 @@ BubbleColor::Mask& operator-= (BubbleColor::Mask& left, const BubbleColor& right
 
 
 
+/* Just created bubbles of a single model, initialized together by BubbleModel::initBatch */
+class BubbleBatch
+{
+private:
+	std::span<Bubble* const> _bubbles;
+	std::span<const BubbleColor> _colors;
+	bool _editorMode;
+
+public:
+	BubbleBatch(std::span<Bubble* const> bubbles, std::span<const BubbleColor> colors, bool editorMode);
+	~BubbleBatch();
+
+	size_t size() const;
+
+	Bubble* getBubble(size_t index) const;
+	const BubbleColor& getColor(size_t index) const;
+
+	bool isEditorMode() const;
+};
+
+
+
+
 struct BubbleModel
 {
 	/* PROPERTIES */
 	std::string name;
+	ModelId id;
 
 	BubbleColorType colorType;
 
@@ -112,6 +150,8 @@ struct BubbleModel
 
 	/* FUNCTIONS */
 	std::function<void(Bubble*, BubbleColor, bool)> init;
+	/* Optional. Replaces init when bubbles are created in batches */
+	std::function<void(const BubbleBatch&)> initBatch;
 
 	std::function<void(Bubble*, Bubble*)> onCollide;
 	std::function<void(Bubble*)> onInserted;
@@ -142,12 +182,76 @@ public:
 	void setTopEnabled(bool flag);
 	void setBottomEnabled(bool flag);
 
+	const sf::IntRect& getBounds() const;
+	bool isTopEnabled() const;
+	bool isBottomEnabled() const;
+
 	BounceEdge check();
 };
 
 
 
 
+/*
+ * Model-sized local variables of a bubble packed as 32-bit slots: ints, then floats,
+ * then interned string ids. Up to InlineSlots live inside the bubble itself; bigger
+ * models take a single heap block.
+ */
+class BubbleLocals
+{
+public:
+	static constexpr UInt32 InlineSlots = 8;
+
+private:
+	union
+	{
+		UInt32 _inline[InlineSlots];
+		UInt32* _heap;
+	};
+	UInt8 _ints;
+	UInt8 _floats;
+	UInt8 _strings;
+
+public:
+	BubbleLocals(UInt8 ints = 0, UInt8 floats = 0, UInt8 strings = 0);
+	BubbleLocals(const BubbleLocals& locals);
+	BubbleLocals(BubbleLocals&& locals) noexcept;
+	~BubbleLocals();
+
+	BubbleLocals& operator= (const BubbleLocals& locals);
+	BubbleLocals& operator= (BubbleLocals&& locals) noexcept;
+
+	UInt8 getIntCount() const;
+	UInt8 getFloatCount() const;
+	UInt8 getStringCount() const;
+
+	Int32 getInt(UInt8 index) const;
+	float getFloat(UInt8 index) const;
+	const std::string& getString(UInt8 index) const;
+
+	void setInt(UInt8 index, Int32 value);
+	void setFloat(UInt8 index, float value);
+	void setString(UInt8 index, const std::string& value);
+
+private:
+	UInt32 size() const;
+	bool isInline() const;
+
+	UInt32* slots();
+	const UInt32* slots() const;
+
+	void _copy(const BubbleLocals& locals);
+	void _move(BubbleLocals&& locals) noexcept;
+	void _del();
+
+public:
+	static UInt32 intern(const std::string& str);
+	static const std::string& interned(UInt32 id);
+};
+
+
+
+
 class Bubble : public Object, public sf::Transformable
 {
 public:
@@ -173,9 +277,7 @@ private:
 
 	BouncingBounds _bounce;
 
-	std::vector<Int32> _localInts;
-	std::vector<float> _localFloats;
-	std::vector<std::string> _localStrings;
+	BubbleLocals _locals;
 
 public:
 	Bubble(const Ref<BubbleModel>& model, TextureManager& textures = TextureManager::root());
@@ -204,6 +306,9 @@ public:
 	AnimatedSprite* getSprite();
 	const AnimatedSprite* getSprite() const;
 
+	BouncingBounds& getBouncingBounds();
+	const BouncingBounds& getBouncingBounds() const;
+
 
 	/* Model functions */
 	Int8 getResistence() const;
@@ -229,14 +334,79 @@ public:
 
 
 
+/*
+ * Motion state of the bubbles in flight, kept as parallel arrays so a step only
+ * touches positions, speeds, accelerations and bounce limits. The bubble itself
+ * is not updated until it is released from the store.
+ */
+class BubbleKinematics
+{
+public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+	std::vector<Ref<Bubble>> _bubbles;
+	std::vector<float> _px, _py;
+	std::vector<float> _vx, _vy;
+	std::vector<float> _ax, _ay;
+	std::vector<float> _minX, _maxX, _minY, _maxY;
+	std::vector<BounceEdge> _edges;
+
+public:
+	BubbleKinematics();
+	~BubbleKinematics();
+
+	NON_COPYABLE_MOVABLE(BubbleKinematics);
+
+	/*
+	 * Appends the bubble and returns its index, npos for null. Bubbles are not checked for
+	 * duplicates, so adding a batch stays linear: callers add each bubble once.
+	 */
+	size_t add(const Ref<Bubble>& bubble);
+
+	/* Linear scan, for the rare lookups by bubble */
+	size_t find(const Ref<Bubble>& bubble) const;
+
+	/* Writes the motion state back to the bubble and removes it. Returns the released bubble */
+	Ref<Bubble> release(size_t index);
+
+	/* Removes the bubble without touching it. The last entry takes its index */
+	void remove(size_t index);
+
+	void clear();
+	void reserve(size_t count);
+
+	void step(float delta);
+
+	size_t size() const;
+	bool empty() const;
+
+	const Ref<Bubble>& getBubble(size_t index) const;
+	Vec2f getPosition(size_t index) const;
+	Vec2f getSpeed(size_t index) const;
+	Vec2f getAcceleration(size_t index) const;
+	BounceEdge getLastBounce(size_t index) const;
+
+	/* Packed positions by entry index, as taken by SpatialHash::build */
+	std::span<const float> getPositionsX() const;
+	std::span<const float> getPositionsY() const;
+
+	void setSpeed(size_t index, const Vec2f& speed);
+	void setAcceleration(size_t index, const Vec2f& acceleration);
+};
+
+
+
+
+/* Model id and color code packed in 32 bits, so comparing or copying identifiers is an integer operation */
 class BubbleIdentifier
 {
 private:
-	std::string _model;
-	BubbleColor _color;
+	UInt32 _code;
 
 public:
 	BubbleIdentifier();
+	BubbleIdentifier(ModelId model, const BubbleColor& color);
 	BubbleIdentifier(const std::string& model, const BubbleColor& color);
 	BubbleIdentifier(const BubbleIdentifier&) = default;
 	BubbleIdentifier(BubbleIdentifier&&) = default;
@@ -256,30 +426,52 @@ public:
 	const std::string& model() const;
 	void model(const std::string& model);
 
-	const BubbleColor& color() const;
+	ModelId modelId() const;
+	void modelId(ModelId model);
+
+	BubbleColor color() const;
 	void color(const BubbleColor& color);
 
+	UInt32 code() const;
+
 	Ref<Bubble> createBubble(BubbleHeap& heap, TextureManager& textures, bool editorMode) const;
 
 	static BubbleIdentifier invalid();
+
+	/* Inverse of code() */
+	static BubbleIdentifier fromCode(UInt32 code);
 };
 
 
 
 
+/*
+ * Model names are interned into dense ModelIds the first time they are seen, even
+ * before the model is created, so levels can refer to models defined later.
+ */
 class BubbleModelManager : private Manager<BubbleModel>
 {
 private:
-	std::string _defaultModel;
+	ModelId _defaultModel;
+	std::unordered_map<std::string, ModelId> _ids;
+	std::vector<std::string> _names;
+	std::vector<Ref<BubbleModel>> _models;
 
 public:
 	~BubbleModelManager();
 
 	static Ref<BubbleModel> createModel(const std::string& name);
 	static Ref<BubbleModel> getModel(const std::string& name);
+	static Ref<BubbleModel> getModel(ModelId id);
 	static bool hasModel(const std::string& name);
+	static bool hasModel(ModelId id);
 	static Ref<BubbleModel> getDefaultModel();
 
+	/* Id of the name, registering it if new. Empty names are 0 */
+	static ModelId internModel(const std::string& name);
+	static ModelId findModelId(const std::string& name);
+	static const std::string& getModelName(ModelId id);
+
 private:
 	static BubbleModelManager Instance;
 
@@ -293,13 +485,46 @@ private:
 
 class BubbleHeap : private MemoryAllocator<Bubble>
 {
+public:
+	struct BatchStats
+	{
+		UInt32 bubbles = 0;
+		UInt32 groups = 0;
+		sf::Time elapsed;
+	};
+
+private:
+	BatchStats _lastBatch;
+
 public:
 	BubbleHeap();
 	~BubbleHeap();
 
 	Ref<Bubble> create(const std::string& modelName, TextureManager& textures, bool editorMode, const BubbleColor& color = BubbleColor::defaultColor());
 	Ref<Bubble> create(const BubbleIdentifier& identifier, TextureManager& textures, bool editorMode);
+	Ref<Bubble> create(const Ref<BubbleModel>& model, TextureManager& textures, bool editorMode, const BubbleColor& color);
 	void destroy(const Ref<Bubble>& bub);
+
+	/*
+	 * One bubble per identifier, null for invalid ones. Unknown models fall back to the default
+	 * model, as in create(). Bubbles are grouped by model: the pool is grown once for the whole
+	 * batch, each model is resolved once and its bubbles are initialized with a single initBatch
+	 * call when the model has one. Cells come from the free list first, so a batch is not
+	 * necessarily contiguous in memory.
+	 */
+	std::vector<Ref<Bubble>> createBatch(std::span<const BubbleIdentifier> identifiers, TextureManager& textures, bool editorMode);
+
+	/* Size and duration of the last createBatch() */
+	const BatchStats& getLastBatchStats() const;
+
+	bool isArenaMode() const;
+	void setArenaMode(bool enabled);
+
+	void reserve(size_t bubbles);
+	void reset();
+
+	size_t getHighWaterMark() const;
+	size_t getHighWaterBytes() const;
 };
 
 
@@ -327,6 +552,7 @@ public:
 
 	void setModelScore(const std::string& model, UInt16 score);
 	UInt16 getModelScore(const std::string& model) const;
+	const std::map<std::string, UInt16>& getModelScores() const;
 
 	Ref<BubbleModel> selectModel(RNG& rand) const;
 
@@ -2,11 +2,11 @@
 
 #include <chrono>
 
-UInt64 ID::_gen{ 0 };
+std::atomic<UInt64> ID::_gen{ 0 };
 
 ID ID::generate()
 {
-	return { ++_gen };
+	return { _gen.fetch_add(1, std::memory_order_relaxed) + 1 };
 }
 
 bool operator== (const ID& id0, const ID& id1) { return id0._id == id1._id; }
@@ -22,7 +22,7 @@ bool operator! (const ID& id) { return !id._id; }
 std::ostream& operator<< (std::ostream& os, const ID& id) { return os << id._id; }
 std::istream& operator>> (std::istream& is, ID& id) { return is >> id._id; }
 
-size_t ID::Hash::operator() (const ID& id)
+size_t ID::Hash::operator() (const ID& id) const
 {
 	return std::hash<UInt64>()(id._id);
 }
@@ -30,10 +30,16 @@ size_t ID::Hash::operator() (const ID& id)
 
 
 Object::Object() :
-	_id{}
+	_id{ ID::generate() }
+{}
+Object::Object(const Object&) :
+	_id{ ID::generate() }
 {}
 Object::~Object() {}
 
+Object& Object::operator= (const Object&) { return *this; }
+Object& Object::operator= (Object&&) noexcept { return *this; }
+
 const ID& Object::id() const { return _id; }
 
 bool operator== (const Object& left, const Object& right) { return left._id == right._id; }
@@ -5,6 +5,7 @@
 
 #include <type_traits>
 #include <functional>
+#include <atomic>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
@@ -51,7 +52,7 @@ class ID
 {
 private:
 	UInt64 _id;
-	static UInt64 _gen;
+	static std::atomic<UInt64> _gen;
 
 	constexpr ID(UInt64 code) : _id{ code } {}
 
@@ -81,7 +82,8 @@ public:
 public:
 	class Hash
 	{
-		size_t operator() (const ID& id);
+	public:
+		size_t operator() (const ID& id) const;
 	};
 	friend class ID::Hash;
 };
@@ -94,8 +96,15 @@ private:
 
 public:
 	explicit Object();
+	/* A copy is a new object with its own ID. Moving keeps the ID, as relocation does */
+	Object(const Object&);
+	Object(Object&&) noexcept = default;
 	virtual ~Object();
 
+	/* Assigning never changes the ID of the target */
+	Object& operator= (const Object&);
+	Object& operator= (Object&&) noexcept;
+
 	const ID& id() const;
 
 	friend bool operator== (const Object& left, const Object& right);
@@ -87,16 +87,17 @@ void GameController::init()
 void GameController::update(const sf::Time& delta)
 {
 	if (!_close)
-		for (GameObject& obj : gameObjectAllocator())
-			obj.update(delta);
+	{
+		updateGameObjects(delta);
+		commitGameObjects();
+	}
 }
 void GameController::render()
 {
 	if (!_close)
 	{
 		_window.clear();
-		for (GameObject& obj : gameObjectAllocator())
-			obj.render(_window);
+		renderGameObjects(_window);
 		_window.display();
 	}
 }
@@ -112,9 +113,9 @@ void GameController::processEvents()
 				_close = true;
 				return;
 			}
-			for (GameObject& obj : gameObjectAllocator())
-				obj.dispatchEvent(event);
+			dispatchEventToGameObjects(event);
 		}
+		commitGameObjects();
 	}
 }
 
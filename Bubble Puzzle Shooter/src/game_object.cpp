@@ -2,7 +2,9 @@
 
 GameObject::GameObject() :
 	Object{},
-	_tag{}
+	_gc{ nullptr },
+	_tag{},
+	_state{ GameObjectState::Spawning }
 {}
 GameObject::~GameObject() {}
 
@@ -11,5 +13,8 @@ void GameObject::tag(const std::string& tag) { _tag = tag; }
 
 bool GameObject::hasAttached() const { return _gc; }
 
+GameObjectState GameObject::getState() const { return _state; }
+bool GameObject::isAlive() const { return _state == GameObjectState::Alive; }
+
 GameController& GameObject::getGameController() { return *_gc; }
 const GameController& GameObject::getGameController() const { return *_gc; }
@@ -5,11 +5,26 @@
 
 class GameController;
 
+template<class _Base>
+class GameObjectContainer;
+
+/*
+ * Spawning: created this tick, not updated until the container commits it.
+ * Dying: destroyed this tick, skipped until the container frees it.
+ */
+enum class GameObjectState : UInt8
+{
+	Spawning,
+	Alive,
+	Dying
+};
+
 class GameObject : public Object, public Renderable, public Updatable, public EventDispatcher
 {
 private:
 	GameController* _gc;
 	std::string _tag;
+	GameObjectState _state;
 
 public:
 	GameObject();
@@ -20,6 +35,9 @@ public:
 
 	bool hasAttached() const;
 
+	GameObjectState getState() const;
+	bool isAlive() const;
+
 	virtual void render(sf::RenderTarget& canvas) override = 0;
 	virtual void update(const sf::Time& delta) override = 0;
 	virtual void dispatchEvent(const sf::Event& event) override = 0;
@@ -30,8 +48,15 @@ protected:
 
 public:
 	friend class GameController;
+
+	template<class _Base>
+	friend class GameObjectContainer;
 };
 
+/* Ref to a game object living in a GameObjectContainer<GameObject> */
+template<typename _Ty>
+using GameObjectRef = Ref<_Ty, GameObject>;
+
 
 template<class _Base>
 class GameObjectContainer
@@ -39,7 +64,23 @@ class GameObjectContainer
 	static_assert(std::is_base_of<GameObject, _Base>::value);
 
 private:
-	MemoryAllocator<_Base> _alloc;
+	/* Per concrete type loops over its pool, calling the overriders without virtual dispatch */
+	struct TypeDispatcher
+	{
+		void (*update)(MemoryAllocator<_Base, true>&, const sf::Time&) = nullptr;
+		void (*dispatchEvent)(MemoryAllocator<_Base, true>&, const sf::Event&) = nullptr;
+	};
+
+	MemoryAllocator<_Base, true> _alloc;
+	std::vector<TypeDispatcher> _dispatchers;
+
+	/* Committed objects in creation order, so later objects keep drawing on top of earlier ones */
+	std::vector<Ref<_Base>> _renderOrder;
+
+	/* Applied by commitGameObjects() at tick boundaries, dispatchers of new types first */
+	std::vector<void (GameObjectContainer::*)()> _pendingTypes;
+	std::vector<Ref<_Base>> _spawned;
+	std::vector<Ref<_Base>> _dying;
 
 protected:
 	virtual void onCreateGameObject(_Base& obj) {}
@@ -47,7 +88,12 @@ protected:
 
 public:
 	GameObjectContainer() :
-		_alloc{}
+		_alloc{},
+		_dispatchers{},
+		_renderOrder{},
+		_pendingTypes{},
+		_spawned{},
+		_dying{}
 	{}
 	~GameObjectContainer() {}
 
@@ -55,73 +101,233 @@ public:
 
 	GameObjectContainer& operator= (const GameObjectContainer&) = delete;
 
+	/* Safe from inside handlers: the object is constructed now but only updated, rendered and notified after the next commit */
 	template<typename _Ty, typename... _Args>
-	Ref<_Ty> createGameObject(_Args&&... args)
+	Ref<_Ty, _Base> createGameObject(_Args&&... args)
 	{
-		Ref<_Ty> ref = _alloc.alloc<_Ty>(args);
-		onCreateGameObject(reinterpret_cast<_Base&>(*ref));
+		deferTypeRegistration<_Ty>();
+		Ref<_Ty, _Base> ref = _alloc.template alloc<_Ty>(std::forward<_Args>(args)...);
+		_spawned.push_back(Ref<_Base>::upcast(ref));
 		return ref;
 	}
 
-	std::vector<Ref<_Base>> findGameObject(const std::function<bool(const _Base&)>& criteria)
+	/* Creates count objects of the same type from the same arguments with a single pool reservation */
+	template<typename _Ty, typename... _Args>
+	std::vector<Ref<_Ty, _Base>> createGameObjects(size_t count, const _Args&... args)
+	{
+		deferTypeRegistration<_Ty>();
+		_alloc.template reserve<_Ty>(_alloc.template countOfType<_Ty>() + count);
+		_spawned.reserve(_spawned.size() + count);
+
+		std::vector<Ref<_Ty, _Base>> refs;
+		refs.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Ref<_Ty, _Base> ref = _alloc.template alloc<_Ty>(args...);
+			_spawned.push_back(Ref<_Base>::upcast(ref));
+			refs.push_back(ref);
+		}
+		return refs;
+	}
+
+	template<typename _Pred>
+	inline std::vector<Ref<_Base>> findGameObject(_Pred&& criteria) const
 	{
-		return _alloc.find(criteria);
+		return _alloc.find(std::forward<_Pred>(criteria));
 	}
 
-	const std::vector<Ref<_Base>> findGameObject(const std::function<bool(const _Base&)>& criteria) const
+	template<typename _Pred>
+	inline Ref<_Base> findFirstGameObject(_Pred&& criteria) const
 	{
-		return _alloc.find(criteria);
+		return _alloc.findFirst(std::forward<_Pred>(criteria));
 	}
 
 	template<typename _Ty>
-	Ref<_Ty> getGameObjectById(const ID& id)
+	Ref<_Ty, _Base> getGameObjectById(const ID& id)
 	{
 		static_assert(std::is_base_of<_Base, _Ty>::value);
-		auto result = find([&id](const _Base& obj) { return obj.id() == id; });
-		if (!result.empty())
-		{
-			if constexpr (std::is_same<_Base, _Ty>::value)
-			{
-				return result[0];
-			}
-			else
-			{
-				return Ref<_Ty>::downcast(result[0]);
-			}
-		}
-
-		return nullptr;
+		return _alloc.template findById<_Ty>(id);
 	}
 
 	template<typename _Ty>
-	inline const Ref<_Ty> getGameObjectById(const ID& id) const { return const_cast<GameObjectContainer*>(this)->getGameObjectById<_Ty>(id); }
+	inline const Ref<_Ty, _Base> getGameObjectById(const ID& id) const { return _alloc.template findById<_Ty>(id); }
 
 	bool containsGameObject(const ID& id) const
 	{
-		return !_alloc.find([&id](const _Base& obj) { return obj.id() == id; }).empty();
+		return _alloc.contains(id);
+	}
+
+	/* Safe while iterating: the object stops being dispatched now and is freed on the next commit */
+	template<typename _Ty>
+	void destroyGameObject(Ref<_Ty, _Base>& ref)
+	{
+		static_assert(std::is_base_of<_Base, _Ty>::value);
+		if (!ref || ref->_state == GameObjectState::Dying)
+			return;
+
+		ref->_state = GameObjectState::Dying;
+		_dying.push_back(Ref<_Base>::upcast(ref));
 	}
 
 	template<typename _Ty>
-	void destroyGameObject(Ref<_Ty>& ref)
+	void destroyGameObjects(std::vector<Ref<_Ty, _Base>>& refs)
+	{
+		_dying.reserve(_dying.size() + refs.size());
+		for (Ref<_Ty, _Base>& ref : refs)
+			destroyGameObject(ref);
+	}
+
+	bool hasPendingGameObjects() const { return !_spawned.empty() || !_dying.empty(); }
+
+	template<typename _Func>
+	inline void forEachGameObject(_Func&& action) { _alloc.forEach(std::forward<_Func>(action)); }
+
+	template<typename _Func>
+	inline void forEachGameObject(_Func&& action) const { _alloc.forEach(std::forward<_Func>(action)); }
+
+	/* Visits the game objects whose concrete type is exactly _Ty with static dispatch on _Ty& */
+	template<typename _Ty, typename _Func>
+	void forEachOfType(_Func&& action)
+	{
+		static_assert(std::is_base_of<_Base, _Ty>::value);
+		_alloc.template forEachOfType<_Ty>(std::forward<_Func>(action));
+	}
+
+	template<typename _Ty, typename _Func>
+	void forEachOfType(_Func&& action) const
 	{
 		static_assert(std::is_base_of<_Base, _Ty>::value);
-		onDestroyGameObject(ref);
-		_alloc.free(ref);
+		_alloc.template forEachOfType<_Ty>(std::forward<_Func>(action));
 	}
 
-	void forEachGameObject(const std::function<void(_Base&)>& action) { _alloc.forEach(action); }
-	void forEachGameObject(const std::function<void(const _Base&)>& action) const { _alloc.forEach(action); }
+	template<typename _Ty>
+	inline size_t countOfType() const { return _alloc.template countOfType<_Ty>(); }
 
 
 
 	template<typename _Ty>
-	inline Ref<_Ty> operator[] (const ID& id) { return getGameObjectById<_Ty>(id); }
+	inline Ref<_Ty, _Base> operator[] (const ID& id) { return getGameObjectById<_Ty>(id); }
 
 	template<typename _Ty>
-	inline Ref<_Ty> operator[] (const ID& id) const { return getGameObjectById<_Ty>(id); }
+	inline Ref<_Ty, _Base> operator[] (const ID& id) const { return getGameObjectById<_Ty>(id); }
 
 protected:
-	MemoryAllocator<_Base>& gameObjectAllocator() { return _alloc; }
-	const MemoryAllocator<_Base>& gameObjectAllocator() const { return _alloc; }
+	MemoryAllocator<_Base, true>& gameObjectAllocator() { return _alloc; }
+	const MemoryAllocator<_Base, true>& gameObjectAllocator() const { return _alloc; }
+
+	/*
+	 * Brings the objects created since the last commit to life and frees the destroyed ones in one
+	 * batch. Objects created and destroyed within the same tick still get both notifications.
+	 */
+	void commitGameObjects()
+	{
+		for (auto registration : _pendingTypes)
+			(this->*registration)();
+		_pendingTypes.clear();
+
+		while (!_spawned.empty())
+		{
+			std::vector<Ref<_Base>> spawned;
+			spawned.swap(_spawned);
+			for (Ref<_Base>& ref : spawned)
+			{
+				if (!ref)
+					continue;
+				if (ref->_state == GameObjectState::Spawning)
+					ref->_state = GameObjectState::Alive;
+				_renderOrder.push_back(ref);
+				onCreateGameObject(*ref);
+			}
+		}
+
+		while (!_dying.empty())
+		{
+			std::vector<Ref<_Base>> dying;
+			dying.swap(_dying);
+			for (Ref<_Base>& ref : dying)
+				if (ref)
+					onDestroyGameObject(*ref);
+
+			std::erase_if(_renderOrder, [](const Ref<_Base>& ref) { return !ref || ref->_state == GameObjectState::Dying; });
+			_alloc.free(dying);
+		}
+	}
+
+	/*
+	 * New types only register at commit, but the dispatch loops still index the table up to its
+	 * size on entry and copy each entry, so nothing a handler does can invalidate the loop.
+	 */
+	void updateGameObjects(const sf::Time& delta)
+	{
+		const size_t count = _dispatchers.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			const TypeDispatcher dispatcher = _dispatchers[i];
+			if (dispatcher.update)
+				dispatcher.update(_alloc, delta);
+		}
+	}
+
+	/* Creation order rather than per type: draw order decides what ends on top */
+	void renderGameObjects(sf::RenderTarget& canvas)
+	{
+		const size_t count = _renderOrder.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			Ref<_Base> ref = _renderOrder[i];
+			if (ref && ref->isAlive())
+				ref->render(canvas);
+		}
+	}
+
+	void dispatchEventToGameObjects(const sf::Event& event)
+	{
+		const size_t count = _dispatchers.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			const TypeDispatcher dispatcher = _dispatchers[i];
+			if (dispatcher.dispatchEvent)
+				dispatcher.dispatchEvent(_alloc, event);
+		}
+	}
+
+private:
+	/* Registering from createGameObject() would resize the dispatcher table while it is being dispatched */
+	template<typename _Ty>
+	void deferTypeRegistration()
+	{
+		const size_t index = memory::PoolIndex<_Base>::template of<_Ty>();
+		if (index < _dispatchers.size() && _dispatchers[index].update)
+			return;
+
+		constexpr auto registration = &GameObjectContainer::template registerType<_Ty>;
+		if (std::find(_pendingTypes.begin(), _pendingTypes.end(), registration) == _pendingTypes.end())
+			_pendingTypes.push_back(registration);
+	}
+
+	template<typename _Ty>
+	void registerType()
+	{
+		const size_t index = memory::PoolIndex<_Base>::template of<_Ty>();
+		if (index >= _dispatchers.size())
+			_dispatchers.resize(index + 1);
+
+		TypeDispatcher& dispatcher = _dispatchers[index];
+		if (dispatcher.update)
+			return;
+
+		dispatcher.update = [](MemoryAllocator<_Base, true>& alloc, const sf::Time& delta) {
+			alloc.template forEachOfType<_Ty>([&delta](_Ty& obj) {
+				if (obj.isAlive())
+					obj._Ty::update(delta);
+			});
+		};
+		dispatcher.dispatchEvent = [](MemoryAllocator<_Base, true>& alloc, const sf::Event& event) {
+			alloc.template forEachOfType<_Ty>([&event](_Ty& obj) {
+				if (obj.isAlive())
+					obj._Ty::dispatchEvent(event);
+			});
+		};
+	}
 };
 
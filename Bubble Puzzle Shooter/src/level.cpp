@@ -82,6 +82,107 @@ void MetaGoals::forEachBubbleGoal(const std::function<void(std::pair<const Bubbl
 	for (const auto& p : _bubgoals)
 		action(p);
 }
+void MetaGoals::forEachBubbleGoal(const std::function<void(std::pair<const BubbleIdentifier, UInt32>)>& action) const
+{
+	for (const auto& p : _bubgoals)
+		action(p);
+}
+
+
+
+
+
+GoalTracker::GoalTracker() :
+	_slots{},
+	_goals{},
+	_clearedBoards{ 0 },
+	_clearedBoardsRequired{ 0 },
+	_pending{ 0 }
+{}
+GoalTracker::GoalTracker(const MetaGoals& goals) :
+	GoalTracker{}
+{
+	setup(goals);
+}
+GoalTracker::~GoalTracker() {}
+
+void GoalTracker::setup(const MetaGoals& goals)
+{
+	clear();
+
+	goals.forEachBubbleGoal([this](std::pair<const BubbleIdentifier, UInt32> goal) {
+		if (goal.second > 0 && goal.first && _goals.size() < std::numeric_limits<UInt16>::max())
+			_goals.push_back({ goal.first, goal.second, 0 });
+	});
+
+	/* Slots hold the goal index plus one, so zero is no goal */
+	for (size_t i = 0; i < _goals.size(); i++)
+	{
+		const size_t slot = slotOf(_goals[i].bubble);
+		if (slot >= _slots.size())
+			_slots.resize(slot + SlotsPerModel - slot % SlotsPerModel, 0);
+		_slots[slot] = static_cast<UInt16>(i + 1);
+	}
+
+	_clearedBoardsRequired = goals.getCleanedBoardCount();
+	_pending = static_cast<UInt32>(_goals.size()) + (_clearedBoardsRequired > 0 ? 1 : 0);
+}
+
+void GoalTracker::clear()
+{
+	_slots.clear();
+	_goals.clear();
+	_clearedBoards = 0;
+	_clearedBoardsRequired = 0;
+	_pending = 0;
+}
+
+bool GoalTracker::onBubbleDestroyed(const BubbleIdentifier& bubble)
+{
+	const size_t slot = slotOf(bubble);
+	if (slot >= _slots.size() || _slots[slot] == 0)
+		return false;
+
+	Goal& goal = _goals[_slots[slot] - 1];
+	if (++goal.progress != goal.required)
+		return false;
+
+	_pending--;
+	return true;
+}
+
+bool GoalTracker::onBoardCleared()
+{
+	if (++_clearedBoards != _clearedBoardsRequired)
+		return false;
+
+	_pending--;
+	return true;
+}
+
+bool GoalTracker::hasGoals() const { return !_goals.empty() || _clearedBoardsRequired > 0; }
+bool GoalTracker::isCompleted() const { return _pending == 0; }
+UInt32 GoalTracker::getPendingGoalCount() const { return _pending; }
+
+UInt32 GoalTracker::getProgress(const BubbleIdentifier& bubble) const
+{
+	const Goal* goal = findGoal(bubble);
+	return goal ? goal->progress : 0U;
+}
+UInt32 GoalTracker::getRequired(const BubbleIdentifier& bubble) const
+{
+	const Goal* goal = findGoal(bubble);
+	return goal ? goal->required : 0U;
+}
+
+UInt32 GoalTracker::getClearedBoardCount() const { return _clearedBoards; }
+UInt32 GoalTracker::getClearedBoardRequiredCount() const { return _clearedBoardsRequired; }
+
+const GoalTracker::Goal* GoalTracker::findGoal(const BubbleIdentifier& bubble) const
+{
+	const size_t slot = slotOf(bubble);
+	return slot < _slots.size() && _slots[slot] != 0 ? &_goals[_slots[slot] - 1] : nullptr;
+}
 
 
 
@@ -117,6 +218,7 @@ UInt32 LevelProperties::getClearedBoardRequiredCount() const { return _clearBoar
 void LevelProperties::setClearedBoardRequiredCount(UInt32 amount) { _clearBoardsRequired = amount; }
 
 BubbleColor::Mask LevelProperties::getEnabledColors() const { return _availableColors; }
+void LevelProperties::setEnabledColors(BubbleColor::Mask colors) { _availableColors = colors; }
 bool LevelProperties::isColorEnabled(const BubbleColor& color) const { return _availableColors & color; }
 void LevelProperties::setColorEnabled(const BubbleColor& color, bool enabled) { _availableColors = enabled ? _availableColors + color : _availableColors - color; }
 
@@ -151,6 +253,9 @@ void LevelProperties::setRoofEnabled(bool enabled) { _roof = enabled; }
 bool LevelProperties::isRemoteBubblesEnabled() const { return _remote; }
 void LevelProperties::setRemoteBubblesEnabled(bool enabled) { _remote = enabled; }
 
+bool LevelProperties::isTimerEnabled() const { return _enableTimer; }
+void LevelProperties::setTimerEnabled(bool enabled) { _enableTimer = enabled; }
+
 bool LevelProperties::isHideTimer() const { return _hideTimer; }
 void LevelProperties::setHideTimer(bool enabled) { _hideTimer = enabled; }
 
@@ -166,8 +271,14 @@ void LevelProperties::setTimerMode(TimerMode mode) { _timerMode = mode; }
 bool LevelProperties::isBubbleSwapEnabled() const { return _enableBubbleSwap; }
 void LevelProperties::setBubbleSwapEnabled(bool enabled) { _enableBubbleSwap = enabled; }
 
+bool LevelProperties::isArenaBubblesEnabled() const { return _arenaBubbles; }
+void LevelProperties::setArenaBubblesEnabled(bool enabled) { _arenaBubbles = enabled; }
+
 const std::string& LevelProperties::getBackground() const { return _background; }
 void LevelProperties::setBackground(const std::string& textureName) { _background = textureName; }
 
+const std::string& LevelProperties::getMusic() const { return _music; }
+void LevelProperties::setMusic(const std::string& musicName) { _music = musicName; }
+
 const MetaGoals& LevelProperties::getGoals() const { return _goals; }
 MetaGoals& LevelProperties::peekGoals() { return _goals; }
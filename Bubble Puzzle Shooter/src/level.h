@@ -98,12 +98,76 @@ public:
 	void setBubbleGoals(const BubbleIdentifier& id, UInt32 amount);
 
 	void forEachBubbleGoal(const std::function<void(std::pair<const BubbleIdentifier, UInt32>)>& action);
+	void forEachBubbleGoal(const std::function<void(std::pair<const BubbleIdentifier, UInt32>)>& action) const;
 
 	inline UInt32 getBubbleGoals(const std::string& model, const BubbleColor& color) { return getBubbleGoals({ model, color }); }
 };
 
 
 
+/*
+ * Runtime progress of the MetaGoals of a level. Goals are compiled into a dense table
+ * indexed by model and color, so every destroyed bubble costs one lookup and one counter
+ * update, and completion is a pending goal count. The cleared board goal counts as one
+ * more goal.
+ */
+class GoalTracker
+{
+public:
+	static constexpr UInt32 SlotsPerModel = BubbleColor::Count + 1;
+
+private:
+	struct Goal
+	{
+		BubbleIdentifier bubble;
+		UInt32 required;
+		UInt32 progress;
+	};
+
+	std::vector<UInt16> _slots;
+	std::vector<Goal> _goals;
+	UInt32 _clearedBoards;
+	UInt32 _clearedBoardsRequired;
+	UInt32 _pending;
+
+public:
+	GoalTracker();
+	GoalTracker(const MetaGoals& goals);
+	GoalTracker(const GoalTracker&) = default;
+	GoalTracker(GoalTracker&&) = default;
+	~GoalTracker();
+
+	GoalTracker& operator= (const GoalTracker&) = default;
+	GoalTracker& operator= (GoalTracker&&) = default;
+
+	void setup(const MetaGoals& goals);
+	void clear();
+
+	/* Both return true when the event completes a goal */
+	bool onBubbleDestroyed(const BubbleIdentifier& bubble);
+	bool onBoardCleared();
+
+	bool hasGoals() const;
+	bool isCompleted() const;
+	UInt32 getPendingGoalCount() const;
+
+	UInt32 getProgress(const BubbleIdentifier& bubble) const;
+	UInt32 getRequired(const BubbleIdentifier& bubble) const;
+
+	UInt32 getClearedBoardCount() const;
+	UInt32 getClearedBoardRequiredCount() const;
+
+private:
+	const Goal* findGoal(const BubbleIdentifier& bubble) const;
+
+	static inline size_t slotOf(const BubbleIdentifier& bubble)
+	{
+		return static_cast<size_t>(bubble.modelId()) * SlotsPerModel + bubble.color().index();
+	}
+};
+
+
+
 class BinaryBubbleBoard
 {
 private:
@@ -160,6 +224,7 @@ private:
 	UInt32 _timerEndTime = 90;
 	TimerMode _timerMode = TimerMode::TURN;
 	bool _enableBubbleSwap = true;
+	bool _arenaBubbles = false;
 	std::string _background = "";
 	std::string _music = "";
 	MetaGoals _goals;
@@ -195,6 +260,7 @@ public:
 	void setClearedBoardRequiredCount(UInt32 amount);
 
 	BubbleColor::Mask getEnabledColors() const;
+	void setEnabledColors(BubbleColor::Mask colors);
 	bool isColorEnabled(const BubbleColor& color) const;
 	void setColorEnabled(const BubbleColor& color, bool enabled);
 
@@ -221,6 +287,9 @@ public:
 	bool isRemoteBubblesEnabled() const;
 	void setRemoteBubblesEnabled(bool enabled);
 
+	bool isTimerEnabled() const;
+	void setTimerEnabled(bool enabled);
+
 	bool isHideTimer() const;
 	void setHideTimer(bool enabled);
 
@@ -236,9 +305,16 @@ public:
 	bool isBubbleSwapEnabled() const;
 	void setBubbleSwapEnabled(bool enabled);
 
+	/* Bump-allocates the bubbles of the level, see BubbleGenerator::setup(). Ignored by endless levels */
+	bool isArenaBubblesEnabled() const;
+	void setArenaBubblesEnabled(bool enabled);
+
 	const std::string& getBackground() const;
 	void setBackground(const std::string& textureName);
 
+	const std::string& getMusic() const;
+	void setMusic(const std::string& musicName);
+
 	const MetaGoals& getGoals() const;
 	MetaGoals& peekGoals();
 };
@@ -0,0 +1,539 @@
+#include "levelpack.h"
+
+#include <array>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	constexpr std::array<UInt32, 256> CrcTable = []() {
+		std::array<UInt32, 256> table = {};
+		for (UInt32 i = 0; i < 256; i++)
+		{
+			UInt32 crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320U : 0U);
+			table[i] = crc;
+		}
+		return table;
+	}();
+
+	constexpr UInt64 align8(UInt64 offset) { return (offset + 7) & ~UInt64(7); }
+
+	/* Overflow safe check of [offset, offset + length) against size */
+	constexpr bool fits(UInt64 offset, UInt64 length, UInt64 size) { return offset <= size && length <= size - offset; }
+
+	constexpr UInt64 cellCount(const levelpack::LevelRecord& record)
+	{
+		return static_cast<UInt64>(record.boardCount) * utils::VisibleRows * record.columns;
+	}
+}
+
+UInt32 levelpack::crc32(const void* data, size_t size, UInt32 crc)
+{
+	const UInt8* bytes = static_cast<const UInt8*>(data);
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = CrcTable[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+
+
+
+
+MappedFile::MappedFile() :
+	_data{ nullptr },
+	_size{ 0 }
+#ifdef _WIN32
+	, _file{ INVALID_HANDLE_VALUE },
+	_mapping{ nullptr }
+#endif
+{}
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart <= 0)
+	{
+		close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = _mapping ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view)
+	{
+		close();
+		return false;
+	}
+
+	_data = static_cast<const std::byte*>(view);
+	_size = static_cast<size_t>(size.QuadPart);
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+		view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (view == MAP_FAILED)
+		return false;
+
+	_data = static_cast<const std::byte*>(view);
+	_size = static_cast<size_t>(info.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+	_mapping = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data)
+		munmap(const_cast<std::byte*>(_data), _size);
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+bool MappedFile::isOpen() const { return _data; }
+
+const std::byte* MappedFile::data() const { return _data; }
+size_t MappedFile::size() const { return _size; }
+
+
+
+
+
+LevelView::LevelView() :
+	_pack{ nullptr },
+	_record{ nullptr },
+	_cells{ nullptr },
+	_arrowModels{},
+	_boardModels{},
+	_goals{}
+{}
+LevelView::~LevelView() {}
+
+LevelView::operator bool() const { return _record; }
+bool operator! (const LevelView& right) { return !right._record; }
+
+const levelpack::LevelRecord& LevelView::getRecord() const { return *_record; }
+
+BoardColumnStyle LevelView::getColumns() const { return static_cast<BoardColumnStyle>(_record->columns); }
+UInt32 LevelView::getBubbleBoardCount() const { return _record->boardCount; }
+
+std::span<const UInt32> LevelView::getBoardCells(UInt32 board) const
+{
+	const size_t size = static_cast<size_t>(utils::VisibleRows) * _record->columns;
+	return { _cells + static_cast<size_t>(board) * size, size };
+}
+BubbleIdentifier LevelView::getBubble(UInt32 board, Row row, Column column) const
+{
+	return _pack->toIdentifier(getBoardCells(board)[static_cast<size_t>(row) * _record->columns + column]);
+}
+
+std::span<const levelpack::ModelScore> LevelView::getArrowModels() const { return _arrowModels; }
+std::span<const levelpack::ModelScore> LevelView::getBoardModels() const { return _boardModels; }
+std::span<const levelpack::BubbleGoal> LevelView::getBubbleGoals() const { return _goals; }
+
+std::string_view LevelView::getBackground() const { return _pack->getString(_record->background); }
+std::string_view LevelView::getMusic() const { return _pack->getString(_record->music); }
+
+void LevelView::load(LevelProperties& props) const
+{
+	const levelpack::LevelRecord& record = *_record;
+	props = {};
+
+	props.setColuns(getColumns());
+	props.setPlayer(static_cast<PlayerId>(record.player));
+	props.setBubbleBoardCount(record.boardCount);
+	for (UInt32 board = 0; board < record.boardCount; board++)
+	{
+		BinaryBubbleBoard& target = props.peekBubbleBoard(board);
+		const UInt32* cells = getBoardCells(board).data();
+		for (Row row = 0; row < utils::VisibleRows; row++)
+			for (Column column = 0; column < record.columns; column++)
+				target.peekBubble(row, column) = _pack->toIdentifier(*cells++);
+	}
+
+	props.setHiddenBubbleContainerType(static_cast<HiddenBubbleContainerType>(record.hideType));
+	props.setClearedBoardRequiredCount(record.clearBoardsRequired);
+	props.setEnabledColors(record.colors);
+	props.setSeed(record.seed);
+	props.setInitialFilledRows(record.initialRows);
+	props.setBubbleGenerationEnabled(record.flags & levelpack::flags::BubbleGeneration);
+
+	for (const levelpack::ModelScore& model : _arrowModels)
+		props.peekArrowModelSelector().setModelScore(BubbleModelManager::getModelName(_pack->getModelId(model.model)), static_cast<UInt16>(model.score));
+	for (const levelpack::ModelScore& model : _boardModels)
+		props.peekBoardModelSelector().setModelScore(BubbleModelManager::getModelName(_pack->getModelId(model.model)), static_cast<UInt16>(model.score));
+
+	props.setRoofEnabled(record.flags & levelpack::flags::Roof);
+	props.setRemoteBubblesEnabled(record.flags & levelpack::flags::RemoteBubbles);
+	props.setTimerEnabled(record.flags & levelpack::flags::Timer);
+	props.setHideTimer(record.flags & levelpack::flags::HideTimer);
+	props.setTimerTurnTime(record.timerTurnTime);
+	props.setTimerEndTime(record.timerEndTime);
+	props.setTimerMode(static_cast<TimerMode>(record.timerMode));
+	props.setBubbleSwapEnabled(record.flags & levelpack::flags::BubbleSwap);
+	props.setArenaBubblesEnabled(record.flags & levelpack::flags::ArenaBubbles);
+	props.setBackground(std::string{ getBackground() });
+	props.setMusic(std::string{ getMusic() });
+
+	MetaGoals& goals = props.peekGoals();
+	goals.setCleanedBoardCount(record.clearedBoardGoal);
+	for (const levelpack::BubbleGoal& goal : _goals)
+		goals.setBubbleGoals(_pack->toIdentifier(goal.bubble), goal.amount);
+}
+
+
+
+
+
+LevelPack::LevelPack() :
+	_file{},
+	_header{ nullptr },
+	_index{},
+	_models{}
+{}
+LevelPack::~LevelPack() {}
+
+bool LevelPack::open(const std::string& path, bool verifyChecksum)
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	if (!validate() || (verifyChecksum && !verify()))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void LevelPack::close()
+{
+	_file.close();
+	_header = nullptr;
+	_index = {};
+	_models.clear();
+}
+
+bool LevelPack::isOpen() const { return _header; }
+
+bool LevelPack::verify() const
+{
+	if (!_header)
+		return false;
+
+	constexpr size_t offset = sizeof(levelpack::Header);
+	return levelpack::crc32(_file.data() + offset, _file.size() - offset) == _header->checksum;
+}
+
+UInt32 LevelPack::getLevelCount() const { return static_cast<UInt32>(_index.size()); }
+
+LevelView LevelPack::getLevel(UInt32 index) const
+{
+	if (index >= _index.size())
+		return {};
+
+	UInt64 offset = _index[index].offset;
+	const levelpack::LevelRecord* record = at<levelpack::LevelRecord>(offset);
+	offset += sizeof(levelpack::LevelRecord);
+
+	LevelView view;
+	view._pack = this;
+	view._record = record;
+	view._cells = at<UInt32>(offset);
+	offset += cellCount(*record) * sizeof(UInt32);
+
+	view._arrowModels = { at<levelpack::ModelScore>(offset), record->arrowModelCount };
+	offset += record->arrowModelCount * sizeof(levelpack::ModelScore);
+
+	view._boardModels = { at<levelpack::ModelScore>(offset), record->boardModelCount };
+	offset += record->boardModelCount * sizeof(levelpack::ModelScore);
+
+	view._goals = { at<levelpack::BubbleGoal>(offset), record->goalCount };
+	return view;
+}
+
+bool LevelPack::load(UInt32 index, LevelProperties& props) const
+{
+	LevelView view = getLevel(index);
+	if (!view)
+		return false;
+
+	view.load(props);
+	return true;
+}
+
+ModelId LevelPack::getModelId(UInt32 packModel) const { return packModel < _models.size() ? _models[packModel] : ModelId(0); }
+
+std::string_view LevelPack::getString(const levelpack::StringRef& ref) const
+{
+	if (!_header || !fits(ref.offset, ref.length, _header->stringsSize))
+		return {};
+	return { at<char>(_header->stringsOffset + ref.offset), ref.length };
+}
+
+bool LevelPack::validate()
+{
+	const UInt64 size = _file.size();
+	if (size < sizeof(levelpack::Header))
+		return false;
+
+	const levelpack::Header& header = *at<levelpack::Header>(0);
+	if (std::memcmp(header.magic, levelpack::Magic, sizeof(levelpack::Magic)) != 0 ||
+		header.version != levelpack::Version ||
+		header.headerSize != sizeof(levelpack::Header) ||
+		header.fileSize != size)
+		return false;
+
+	if (header.modelsOffset % alignof(levelpack::StringRef) != 0 || header.indexOffset % alignof(levelpack::IndexEntry) != 0 ||
+		!fits(header.modelsOffset, static_cast<UInt64>(header.modelCount) * sizeof(levelpack::StringRef), size) ||
+		!fits(header.indexOffset, static_cast<UInt64>(header.levelCount) * sizeof(levelpack::IndexEntry), size) ||
+		!fits(header.stringsOffset, header.stringsSize, size))
+		return false;
+
+	_header = &header;
+	_index = { at<levelpack::IndexEntry>(header.indexOffset), header.levelCount };
+	for (const levelpack::IndexEntry& entry : _index)
+	{
+		if (!validateLevel(entry))
+			return false;
+	}
+
+	/* Pack model 0 is no model */
+	const levelpack::StringRef* names = at<levelpack::StringRef>(header.modelsOffset);
+	_models.assign(static_cast<size_t>(header.modelCount) + 1, ModelId(0));
+	for (UInt32 i = 0; i < header.modelCount; i++)
+	{
+		if (!fits(names[i].offset, names[i].length, header.stringsSize))
+			return false;
+		_models[i + 1] = BubbleModelManager::internModel(std::string{ getString(names[i]) });
+	}
+	return true;
+}
+
+bool LevelPack::validateLevel(const levelpack::IndexEntry& entry) const
+{
+	if (entry.offset % 8 != 0 || entry.size < sizeof(levelpack::LevelRecord) || !fits(entry.offset, entry.size, _file.size()))
+		return false;
+
+	const levelpack::LevelRecord& record = *at<levelpack::LevelRecord>(entry.offset);
+	if (record.columns < utils::MinColumnCount || record.columns > utils::MaxColumnCount)
+		return false;
+
+	const UInt64 required = sizeof(levelpack::LevelRecord) +
+		cellCount(record) * sizeof(UInt32) +
+		(static_cast<UInt64>(record.arrowModelCount) + record.boardModelCount) * sizeof(levelpack::ModelScore) +
+		static_cast<UInt64>(record.goalCount) * sizeof(levelpack::BubbleGoal);
+
+	return required <= entry.size &&
+		fits(record.background.offset, record.background.length, _header->stringsSize) &&
+		fits(record.music.offset, record.music.length, _header->stringsSize);
+}
+
+
+
+
+
+LevelPackWriter::LevelPackWriter() :
+	_blobs{},
+	_index{},
+	_modelNames{},
+	_models{},
+	_strings{}
+{}
+LevelPackWriter::~LevelPackWriter() {}
+
+UInt32 LevelPackWriter::getLevelCount() const { return static_cast<UInt32>(_index.size()); }
+
+void LevelPackWriter::add(const LevelProperties& props)
+{
+	levelpack::LevelRecord record = {};
+	record.columns = static_cast<UInt8>(utils::styleToColumn(props.getColuns()));
+	record.player = static_cast<UInt8>(props.getPlayer());
+	record.hideType = static_cast<UInt8>(props.getHiddenBubbleContainerType());
+	record.colors = props.getEnabledColors();
+	record.timerMode = static_cast<UInt8>(props.getTimerMode());
+	record.boardCount = static_cast<UInt16>(props.getBubbleBoardCount());
+	record.clearBoardsRequired = props.getClearedBoardRequiredCount();
+	record.seed = props.getSeed();
+	record.initialRows = props.getInitialFilledRows();
+	record.timerTurnTime = props.getTimerTurnTime();
+	record.timerEndTime = props.getTimerEndTime();
+	record.clearedBoardGoal = props.getGoals().getCleanedBoardCount();
+	record.background = packString(props.getBackground());
+	record.music = packString(props.getMusic());
+
+	if (props.isBubbleGenerationEnabled()) record.flags |= levelpack::flags::BubbleGeneration;
+	if (props.isRoofEnabled()) record.flags |= levelpack::flags::Roof;
+	if (props.isRemoteBubblesEnabled()) record.flags |= levelpack::flags::RemoteBubbles;
+	if (props.isTimerEnabled()) record.flags |= levelpack::flags::Timer;
+	if (props.isHideTimer()) record.flags |= levelpack::flags::HideTimer;
+	if (props.isBubbleSwapEnabled()) record.flags |= levelpack::flags::BubbleSwap;
+	if (props.isArenaBubblesEnabled()) record.flags |= levelpack::flags::ArenaBubbles;
+
+	std::vector<UInt32> cells;
+	cells.reserve(static_cast<size_t>(cellCount(record)));
+	for (UInt32 board = 0; board < record.boardCount; board++)
+	{
+		const BinaryBubbleBoard& source = props.getBubbleBoard(board);
+		for (Row row = 0; row < utils::VisibleRows; row++)
+		{
+			const std::vector<BubbleIdentifier>& bubbles = source.peekRow(row);
+			for (Column column = 0; column < record.columns; column++)
+				cells.push_back(column < bubbles.size() ? packCode(bubbles[column]) : 0U);
+		}
+	}
+
+	std::vector<levelpack::ModelScore> arrowModels, boardModels;
+	for (const auto& model : props.getArrowModelSelector().getModelScores())
+		arrowModels.push_back({ packModel(model.first), model.second });
+	for (const auto& model : props.getBoardModelSelector().getModelScores())
+		boardModels.push_back({ packModel(model.first), model.second });
+	record.arrowModelCount = static_cast<UInt16>(arrowModels.size());
+	record.boardModelCount = static_cast<UInt16>(boardModels.size());
+
+	std::vector<levelpack::BubbleGoal> goals;
+	props.getGoals().forEachBubbleGoal([this, &goals](std::pair<const BubbleIdentifier, UInt32> goal) {
+		goals.push_back({ packCode(goal.first), goal.second });
+	});
+	record.goalCount = static_cast<UInt32>(goals.size());
+
+	const size_t offset = _blobs.size();
+	append(&record, 1);
+	append(cells.data(), cells.size());
+	append(arrowModels.data(), arrowModels.size());
+	append(boardModels.data(), boardModels.size());
+	append(goals.data(), goals.size());
+
+	_index.push_back({ offset, static_cast<UInt32>(_blobs.size() - offset), 0 });
+	_blobs.resize(static_cast<size_t>(align8(_blobs.size())));
+}
+
+void LevelPackWriter::clear()
+{
+	_blobs.clear();
+	_index.clear();
+	_modelNames.clear();
+	_models.clear();
+	_strings.clear();
+}
+
+std::vector<std::byte> LevelPackWriter::build() const
+{
+	levelpack::Header header = {};
+	std::memcpy(header.magic, levelpack::Magic, sizeof(levelpack::Magic));
+	header.version = levelpack::Version;
+	header.headerSize = sizeof(levelpack::Header);
+	header.levelCount = static_cast<UInt32>(_index.size());
+	header.modelCount = static_cast<UInt32>(_modelNames.size());
+	header.modelsOffset = sizeof(levelpack::Header);
+	header.indexOffset = align8(header.modelsOffset + _modelNames.size() * sizeof(levelpack::StringRef));
+	header.stringsOffset = header.indexOffset + _index.size() * sizeof(levelpack::IndexEntry);
+	header.stringsSize = _strings.size();
+
+	const UInt64 dataOffset = align8(header.stringsOffset + header.stringsSize);
+	header.fileSize = dataOffset + _blobs.size();
+
+	std::vector<std::byte> pack(static_cast<size_t>(header.fileSize));
+	std::memcpy(pack.data() + header.modelsOffset, _modelNames.data(), _modelNames.size() * sizeof(levelpack::StringRef));
+	std::memcpy(pack.data() + header.stringsOffset, _strings.data(), _strings.size());
+	std::memcpy(pack.data() + dataOffset, _blobs.data(), _blobs.size());
+
+	levelpack::IndexEntry* index = reinterpret_cast<levelpack::IndexEntry*>(pack.data() + header.indexOffset);
+	for (size_t i = 0; i < _index.size(); i++)
+	{
+		index[i] = _index[i];
+		index[i].offset += dataOffset;
+	}
+
+	header.checksum = levelpack::crc32(pack.data() + sizeof(levelpack::Header), pack.size() - sizeof(levelpack::Header));
+	std::memcpy(pack.data(), &header, sizeof(levelpack::Header));
+	return pack;
+}
+
+bool LevelPackWriter::write(const std::string& path) const
+{
+	const std::vector<std::byte> pack = build();
+	std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(pack.data()), static_cast<std::streamsize>(pack.size()));
+	return static_cast<bool>(file);
+}
+
+bool LevelPackWriter::convert(const LevelPack& pack, const std::string& path)
+{
+	LevelPackWriter writer;
+	LevelProperties props;
+	for (UInt32 i = 0; i < pack.getLevelCount(); i++)
+	{
+		if (!pack.load(i, props))
+			return false;
+		writer.add(props);
+	}
+	return writer.write(path);
+}
+
+UInt32 LevelPackWriter::packModel(const std::string& name)
+{
+	auto it = _models.find(name);
+	if (it != _models.end())
+		return it->second;
+
+	_modelNames.push_back(packString(name));
+	const UInt32 model = static_cast<UInt32>(_modelNames.size());
+	_models.emplace(name, model);
+	return model;
+}
+
+UInt32 LevelPackWriter::packCode(const BubbleIdentifier& id)
+{
+	const UInt32 model = id.isInvalid() ? 0U : packModel(id.model());
+	return (model << 8) | (id.code() & 0xff);
+}
+
+levelpack::StringRef LevelPackWriter::packString(const std::string& str)
+{
+	const levelpack::StringRef ref = { static_cast<UInt32>(_strings.size()), static_cast<UInt32>(str.size()) };
+	_strings += str;
+	return ref;
+}
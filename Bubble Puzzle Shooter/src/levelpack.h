@@ -0,0 +1,276 @@
+#pragma once
+
+#include <span>
+#include <unordered_map>
+
+#include "level.h"
+
+
+/*
+ * Binary level packs. Layout, all little endian and naturally aligned:
+ *
+ *   Header
+ *   StringRef  models[modelCount]       model names, pack model n is models[n - 1]
+ *   IndexEntry index[levelCount]
+ *   char       strings[stringsSize]     names, not null terminated
+ *   level blobs, each 8 byte aligned:
+ *     LevelRecord
+ *     UInt32     cells[boardCount][VisibleRows][columns]
+ *     ModelScore arrowModels[arrowModelCount]
+ *     ModelScore boardModels[boardModelCount]
+ *     BubbleGoal goals[goalCount]
+ *
+ * Cells and goals hold BubbleIdentifier codes whose model part is a pack model, since
+ * ModelIds are only meaningful inside one process. The checksum is the CRC-32 of
+ * everything after the header.
+ */
+namespace levelpack
+{
+	constexpr char Magic[4] = { 'B', 'P', 'L', 'K' };
+	constexpr UInt16 Version = 1;
+
+	struct Header
+	{
+		char magic[4];
+		UInt16 version;
+		UInt16 headerSize;
+		UInt32 levelCount;
+		UInt32 modelCount;
+		UInt64 modelsOffset;
+		UInt64 indexOffset;
+		UInt64 stringsOffset;
+		UInt64 stringsSize;
+		UInt64 fileSize;
+		UInt32 checksum;
+		UInt32 reserved;
+	};
+
+	struct StringRef
+	{
+		UInt32 offset;
+		UInt32 length;
+	};
+
+	struct IndexEntry
+	{
+		UInt64 offset;
+		UInt32 size;
+		UInt32 reserved;
+	};
+
+	namespace flags
+	{
+		constexpr UInt8 BubbleGeneration = 0x01;
+		constexpr UInt8 Roof = 0x02;
+		constexpr UInt8 RemoteBubbles = 0x04;
+		constexpr UInt8 Timer = 0x08;
+		constexpr UInt8 HideTimer = 0x10;
+		constexpr UInt8 BubbleSwap = 0x20;
+		constexpr UInt8 ArenaBubbles = 0x40;
+	}
+
+	struct LevelRecord
+	{
+		UInt8 columns;
+		UInt8 player;
+		UInt8 hideType;
+		UInt8 colors;
+		UInt8 timerMode;
+		UInt8 flags;
+		UInt16 boardCount;
+		UInt32 clearBoardsRequired;
+		UInt32 seed;
+		UInt32 initialRows;
+		UInt32 timerTurnTime;
+		UInt32 timerEndTime;
+		UInt32 clearedBoardGoal;
+		StringRef background;
+		StringRef music;
+		UInt16 arrowModelCount;
+		UInt16 boardModelCount;
+		UInt32 goalCount;
+	};
+
+	struct ModelScore
+	{
+		UInt32 model;
+		UInt32 score;
+	};
+
+	struct BubbleGoal
+	{
+		UInt32 bubble;
+		UInt32 amount;
+	};
+
+	static_assert(sizeof(Header) == 64);
+	static_assert(sizeof(IndexEntry) == 16);
+	static_assert(sizeof(LevelRecord) == 56);
+
+	UInt32 crc32(const void* data, size_t size, UInt32 crc = 0);
+}
+
+
+
+/* Read only view of a whole file, memory mapped when the platform allows it */
+class MappedFile
+{
+private:
+	const std::byte* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	NON_COPYABLE_MOVABLE(MappedFile);
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+
+	const std::byte* data() const;
+	size_t size() const;
+};
+
+
+
+class LevelPack;
+
+/* Zero-copy view of one level of an open pack. Valid while the pack stays open */
+class LevelView
+{
+private:
+	const LevelPack* _pack;
+	const levelpack::LevelRecord* _record;
+	const UInt32* _cells;
+	std::span<const levelpack::ModelScore> _arrowModels;
+	std::span<const levelpack::ModelScore> _boardModels;
+	std::span<const levelpack::BubbleGoal> _goals;
+
+public:
+	LevelView();
+	LevelView(const LevelView&) = default;
+	~LevelView();
+
+	LevelView& operator= (const LevelView&) = default;
+
+	operator bool() const;
+	friend bool operator! (const LevelView& right);
+
+	const levelpack::LevelRecord& getRecord() const;
+
+	BoardColumnStyle getColumns() const;
+	UInt32 getBubbleBoardCount() const;
+
+	/* Raw pack codes of a board, row after row of getColumns() cells */
+	std::span<const UInt32> getBoardCells(UInt32 board) const;
+	BubbleIdentifier getBubble(UInt32 board, Row row, Column column) const;
+
+	std::span<const levelpack::ModelScore> getArrowModels() const;
+	std::span<const levelpack::ModelScore> getBoardModels() const;
+	std::span<const levelpack::BubbleGoal> getBubbleGoals() const;
+
+	std::string_view getBackground() const;
+	std::string_view getMusic() const;
+
+	/* Copies the level out of the pack */
+	void load(LevelProperties& props) const;
+
+	friend class LevelPack;
+};
+
+
+
+/*
+ * Level pack opened in place. open() only checks the header and the index, so it costs
+ * a few microseconds whatever the pack size; verify() checks the whole checksum.
+ */
+class LevelPack
+{
+private:
+	MappedFile _file;
+	const levelpack::Header* _header;
+	std::span<const levelpack::IndexEntry> _index;
+	std::vector<ModelId> _models;
+
+public:
+	LevelPack();
+	~LevelPack();
+
+	NON_COPYABLE_MOVABLE(LevelPack);
+
+	bool open(const std::string& path, bool verifyChecksum = false);
+	void close();
+
+	bool isOpen() const;
+	bool verify() const;
+
+	UInt32 getLevelCount() const;
+	LevelView getLevel(UInt32 index) const;
+
+	bool load(UInt32 index, LevelProperties& props) const;
+
+	/* Process ModelId of a pack model, interned on open */
+	ModelId getModelId(UInt32 packModel) const;
+	std::string_view getString(const levelpack::StringRef& ref) const;
+
+	inline BubbleIdentifier toIdentifier(UInt32 packCode) const
+	{
+		return BubbleIdentifier::fromCode((static_cast<UInt32>(getModelId(packCode >> 8)) << 8) | (packCode & 0xff));
+	}
+
+private:
+	bool validate();
+	bool validateLevel(const levelpack::IndexEntry& entry) const;
+
+	template<typename _Ty>
+	inline const _Ty* at(UInt64 offset) const { return reinterpret_cast<const _Ty*>(_file.data() + offset); }
+};
+
+
+
+/* Builds level packs from in-memory levels */
+class LevelPackWriter
+{
+private:
+	std::vector<std::byte> _blobs;
+	std::vector<levelpack::IndexEntry> _index;
+	std::vector<levelpack::StringRef> _modelNames;
+	std::unordered_map<std::string, UInt32> _models;
+	std::string _strings;
+
+public:
+	LevelPackWriter();
+	~LevelPackWriter();
+
+	NON_COPYABLE_MOVABLE(LevelPackWriter);
+
+	UInt32 getLevelCount() const;
+
+	void add(const LevelProperties& props);
+	void clear();
+
+	std::vector<std::byte> build() const;
+	bool write(const std::string& path) const;
+
+	/* Repacks every level of a pack, e.g. to upgrade its version */
+	static bool convert(const LevelPack& pack, const std::string& path);
+
+private:
+	UInt32 packModel(const std::string& name);
+	UInt32 packCode(const BubbleIdentifier& id);
+	levelpack::StringRef packString(const std::string& str);
+
+	template<typename _Ty>
+	inline void append(const _Ty* values, size_t count)
+	{
+		const std::byte* bytes = reinterpret_cast<const std::byte*>(values);
+		_blobs.insert(_blobs.end(), bytes, bytes + sizeof(_Ty) * count);
+	}
+};
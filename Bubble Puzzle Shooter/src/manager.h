@@ -19,7 +19,7 @@ public:
 		_elems{},
 		_parent{ parent }
 	{}
-	~Manager() {}
+	virtual ~Manager() {}
 
 	bool has(const std::string& name) const
 	{
@@ -59,6 +59,7 @@ public:
 			return false;
 
 		Resource res = it->second;
+		onDestroy(it->first, *res);
 		_elems.erase(it);
 		_alloc.free(res);
 		return true;
@@ -68,19 +69,29 @@ public:
 	{
 		_elems.clear();
 		_alloc.clear();
+		onClear();
 	}
 
 	inline Resource operator[] (const std::string& name) { return get(name); }
 	inline const Resource operator[] (const std::string& name) const { return get(name); }
 
+	inline size_t size() const { return _elems.size(); }
+
+	std::vector<memory::AllocationStats> getAllocationStats() const { return _alloc.stats(); }
+
 protected:
+	/* Called before the element is freed, to release whatever it depends on */
+	virtual void onDestroy(const std::string& /* name */, _Base& /* elem */) {}
+	/* Called once every element has been freed */
+	virtual void onClear() {}
+
 	template<typename _Ty, typename...  _Args>
-	Ref<_Ty> create(const std::string& name, _Args... args)
+	Ref<_Ty, _Base> create(const std::string& name, _Args... args)
 	{
 		if (has(name))
 			return nullptr;
 
-		Ref<_Ty> ref = _alloc.alloc<_Ty>(std::forward<_Args>(args)...);
+		Ref<_Ty, _Base> ref = _alloc.template alloc<_Ty>(std::forward<_Args>(args)...);
 		_elems[name] = Ref<_Base>::upcast(ref);
 		return ref;
 	}
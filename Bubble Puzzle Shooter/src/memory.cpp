@@ -0,0 +1,284 @@
+#include "memory.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace memory
+{
+	SlotTable* SlotTable::Tables[Handle::MaxTable + 1]{};
+	UInt32 SlotTable::NextId{ 0 };
+
+	SlotTable::SlotTable() :
+		_id{ 0 },
+		_slots{},
+		_free{ NoSlot },
+		_size{ 0 }
+	{
+		registerTable();
+	}
+	SlotTable::~SlotTable()
+	{
+		Tables[_id] = nullptr;
+	}
+
+	UInt32 SlotTable::id() const { return _id; }
+	size_t SlotTable::size() const { return _size; }
+
+	Handle SlotTable::acquire(void* data, void* node)
+	{
+		UInt32 index;
+		if (_free != NoSlot)
+		{
+			index = _free;
+			_free = _slots[index].nextFree;
+		}
+		else
+		{
+			if (_slots.size() > Handle::MaxIndex)
+				throw std::length_error{ "slot table is full" };
+			index = static_cast<UInt32>(_slots.size());
+			_slots.push_back({ nullptr, nullptr, 1, NoSlot });
+		}
+
+		Slot& slot = _slots[index];
+		slot.data = data;
+		slot.node = node;
+		slot.nextFree = NoSlot;
+		_size++;
+		return { _id, index, slot.generation };
+	}
+
+	void SlotTable::release(UInt32 index)
+	{
+		Slot& slot = _slots[index];
+		if (!slot.data)
+			return;
+
+		slot.data = nullptr;
+		slot.node = nullptr;
+		slot.generation = slot.generation >= Handle::MaxGeneration ? 1 : slot.generation + 1;
+		slot.nextFree = _free;
+		_free = index;
+		_size--;
+	}
+
+	void SlotTable::relocate(UInt32 index, void* data, void* node)
+	{
+		Slot& slot = _slots[index];
+		slot.data = data;
+		slot.node = node;
+	}
+
+	void SlotTable::clear()
+	{
+		if (_size == 0)
+			return;
+
+		Tables[_id] = nullptr;
+		registerTable();
+		_slots.clear();
+		_free = NoSlot;
+		_size = 0;
+	}
+
+	Handle SlotTable::handle(UInt32 index) const { return { _id, index, _slots[index].generation }; }
+
+	void SlotTable::registerTable()
+	{
+		for (UInt32 i = 0; i <= Handle::MaxTable; i++)
+		{
+			const UInt32 id = (NextId + i) & Handle::MaxTable;
+			if (!Tables[id])
+			{
+				_id = id;
+				Tables[id] = this;
+				NextId = (id + 1) & Handle::MaxTable;
+				return;
+			}
+		}
+		throw std::length_error{ "too many live slot tables" };
+	}
+
+
+
+	AllocationStats& AllocationStats::operator+= (const AllocationStats& right)
+	{
+		live += right.live;
+		peak += right.peak;
+		allocations += right.allocations;
+		frees += right.frees;
+		cellBytes += right.cellBytes;
+		reservedBytes += right.reservedBytes;
+		resourceBytes += right.resourceBytes;
+		return *this;
+	}
+
+
+
+	TrackedAllocator* TrackedAllocator::Head{ nullptr };
+
+	TrackedAllocator::TrackedAllocator() :
+		_prev{ nullptr },
+		_next{ Head }
+	{
+		if (Head)
+			Head->_prev = this;
+		Head = this;
+	}
+	TrackedAllocator::~TrackedAllocator()
+	{
+		if (_prev)
+			_prev->_next = _next;
+		else Head = _next;
+		if (_next)
+			_next->_prev = _prev;
+	}
+
+	std::vector<AllocationStats> collectStats()
+	{
+		std::vector<AllocationStats> raw;
+		for (const TrackedAllocator* alloc = TrackedAllocator::Head; alloc; alloc = alloc->_next)
+			alloc->collectStats(raw);
+
+		std::map<std::string, AllocationStats> merged;
+		for (const auto& st : raw)
+		{
+			auto it = merged.find(st.type);
+			if (it == merged.end())
+				merged[st.type] = st;
+			else it->second += st;
+		}
+
+		std::vector<AllocationStats> stats;
+		for (auto& e : merged)
+			stats.push_back(std::move(e.second));
+		return stats;
+	}
+
+	void dumpStats(std::ostream& os, const std::vector<AllocationStats>& stats)
+	{
+		os << std::left << std::setw(40) << "type" << std::right
+			<< std::setw(10) << "live"
+			<< std::setw(10) << "peak"
+			<< std::setw(12) << "allocs"
+			<< std::setw(12) << "frees"
+			<< std::setw(14) << "cell bytes"
+			<< std::setw(14) << "reserved"
+			<< std::setw(14) << "resources" << std::endl;
+
+		AllocationStats total;
+		for (const auto& st : stats)
+		{
+			os << std::left << std::setw(40) << st.type << std::right
+				<< std::setw(10) << st.live
+				<< std::setw(10) << st.peak
+				<< std::setw(12) << st.allocations
+				<< std::setw(12) << st.frees
+				<< std::setw(14) << st.cellBytes
+				<< std::setw(14) << st.reservedBytes
+				<< std::setw(14) << st.resourceBytes << std::endl;
+			total += st;
+		}
+
+		os << std::left << std::setw(40) << "<total>" << std::right
+			<< std::setw(10) << total.live
+			<< std::setw(10) << total.peak
+			<< std::setw(12) << total.allocations
+			<< std::setw(12) << total.frees
+			<< std::setw(14) << total.cellBytes
+			<< std::setw(14) << total.reservedBytes
+			<< std::setw(14) << total.resourceBytes << std::endl;
+	}
+
+	bool dumpStats(const std::string& filepath)
+	{
+		std::ofstream file{ filepath };
+		if (!file)
+			return false;
+
+		dumpStats(file, collectStats());
+		return true;
+	}
+
+
+
+	IdIndex::IdIndex() :
+		_entries{},
+		_size{ 0 },
+		_shift{ 64 }
+	{}
+	IdIndex::~IdIndex() {}
+
+	size_t IdIndex::size() const { return _size; }
+	bool IdIndex::empty() const { return _size == 0; }
+
+	void IdIndex::insert(const ID& id, Handle handle)
+	{
+		if (!id)
+			return;
+
+		if ((_size + 1) * 2 > _entries.size())
+			rehash(std::max<size_t>(16, _entries.size() * 2));
+
+		const size_t mask = _entries.size() - 1;
+		size_t i = bucket(id);
+		for (; _entries[i].id; i = (i + 1) & mask)
+		{
+			if (_entries[i].id == id)
+			{
+				_entries[i].handle = handle;
+				return;
+			}
+		}
+		_entries[i] = { id, handle };
+		_size++;
+	}
+
+	bool IdIndex::erase(const ID& id)
+	{
+		if (_entries.empty() || !id)
+			return false;
+
+		const size_t mask = _entries.size() - 1;
+		size_t i = bucket(id);
+		for (; _entries[i].id != id; i = (i + 1) & mask)
+			if (!_entries[i].id)
+				return false;
+
+		/* Backward shift: pull later entries of the same probe run into the hole */
+		for (size_t j = (i + 1) & mask; _entries[j].id; j = (j + 1) & mask)
+		{
+			const size_t home = bucket(_entries[j].id);
+			if (((j - home) & mask) >= ((j - i) & mask))
+			{
+				_entries[i] = _entries[j];
+				i = j;
+			}
+		}
+		_entries[i] = {};
+		_size--;
+		return true;
+	}
+
+	void IdIndex::clear()
+	{
+		if (_size == 0)
+			return;
+		std::fill(_entries.begin(), _entries.end(), Entry{});
+		_size = 0;
+	}
+
+	void IdIndex::rehash(size_t capacity)
+	{
+		std::vector<Entry> old{ std::move(_entries) };
+		_entries.assign(capacity, Entry{});
+		_shift = 64;
+		for (size_t c = capacity; c > 1; c >>= 1)
+			_shift--;
+		_size = 0;
+
+		for (const Entry& e : old)
+			if (e.id)
+				insert(e.id, e.handle);
+	}
+}
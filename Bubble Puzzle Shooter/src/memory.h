@@ -1,5 +1,8 @@
 #pragma once
 
+#include <typeinfo>
+#include <iterator>
+
 #include "common.h"
 
 template<typename _Ty>
@@ -108,256 +111,892 @@ public:
 
 namespace memory
 {
+	/*
+	 * Reference to a slot of a SlotTable: 24 bits of slot index, 24 bits of generation
+	 * and 16 bits of table id. The generation is bumped every time a slot is released,
+	 * so a handle to a destroyed object no longer resolves. Code 0 is the null handle.
+	 */
+	class Handle
+	{
+	public:
+		static constexpr UInt32 IndexBits = 24;
+		static constexpr UInt32 GenerationBits = 24;
+		static constexpr UInt32 TableBits = 16;
+
+		static constexpr UInt32 MaxIndex = (1U << IndexBits) - 1;
+		static constexpr UInt32 MaxGeneration = (1U << GenerationBits) - 1;
+		static constexpr UInt32 MaxTable = (1U << TableBits) - 1;
+
+	private:
+		UInt64 _code;
+
+	public:
+		constexpr Handle() : _code{ 0 } {}
+		constexpr Handle(UInt32 table, UInt32 index, UInt32 generation) :
+			_code{
+				(static_cast<UInt64>(table & MaxTable) << (IndexBits + GenerationBits)) |
+				(static_cast<UInt64>(generation & MaxGeneration) << IndexBits) |
+				static_cast<UInt64>(index & MaxIndex)
+			}
+		{}
+		constexpr Handle(const Handle&) = default;
+		constexpr Handle(Handle&&) = default;
+
+		constexpr Handle& operator= (const Handle&) = default;
+		constexpr Handle& operator= (Handle&&) = default;
+
+		constexpr bool operator== (const Handle&) const = default;
+		constexpr auto operator<=> (const Handle&) const = default;
+
+		constexpr UInt32 index() const { return static_cast<UInt32>(_code & MaxIndex); }
+		constexpr UInt32 generation() const { return static_cast<UInt32>((_code >> IndexBits) & MaxGeneration); }
+		constexpr UInt32 table() const { return static_cast<UInt32>(_code >> (IndexBits + GenerationBits)); }
+
+		constexpr UInt64 code() const { return _code; }
+		constexpr bool isNull() const { return _code == 0; }
+	};
+
+
+	/*
+	 * Indirection between handles and object storage. Every table registers itself
+	 * under a 16-bit id so a bare Handle can be resolved without a table pointer.
+	 * Ids are handed out round-robin, so a freed id is not reused until all others
+	 * have been. Objects may be relocated by updating their slot; handles stay valid.
+	 * clear() moves the table to a new id, which drops every outstanding handle at
+	 * once instead of bumping the generation of each slot.
+	 */
+	class SlotTable
+	{
+	public:
+		struct Slot
+		{
+			void* data;
+			void* node;
+			UInt32 generation;
+			UInt32 nextFree;
+		};
+
+	private:
+		static constexpr UInt32 NoSlot = Handle::MaxIndex + 1;
+
+		UInt32 _id;
+		std::vector<Slot> _slots;
+		UInt32 _free;
+		size_t _size;
+
+	public:
+		SlotTable();
+		~SlotTable();
+
+		NON_COPYABLE_MOVABLE(SlotTable);
+
+		UInt32 id() const;
+		size_t size() const;
+
+		Handle acquire(void* data, void* node);
+		void release(UInt32 index);
+		void relocate(UInt32 index, void* data, void* node);
+		void clear();
+
+		Handle handle(UInt32 index) const;
+
+		static inline const Slot* resolve(Handle handle)
+		{
+			const SlotTable* table = Tables[handle.table()];
+			if (!table)
+				return nullptr;
+
+			const std::vector<Slot>& slots = table->_slots;
+			const UInt32 index = handle.index();
+			if (index >= slots.size())
+				return nullptr;
+
+			const Slot& slot = slots[index];
+			return slot.data && slot.generation == handle.generation() ? &slot : nullptr;
+		}
+
+	private:
+		/* Registers the table under the next free id */
+		void registerTable();
+
+		static SlotTable* Tables[Handle::MaxTable + 1];
+		static UInt32 NextId;
+	};
+
+
+	/*
+	 * Open-addressing ID -> Handle map with linear probing and backward-shift erase.
+	 * Entries live in one flat array, so inserting or finding an object by ID never
+	 * allocates once the table has grown to the working set.
+	 */
+	class IdIndex
+	{
+	private:
+		struct Entry
+		{
+			ID id;
+			Handle handle;
+		};
+
+		std::vector<Entry> _entries;
+		size_t _size;
+		UInt32 _shift;
+
+	public:
+		IdIndex();
+		IdIndex(const IdIndex&) = default;
+		IdIndex(IdIndex&&) noexcept = default;
+		~IdIndex();
+
+		IdIndex& operator= (const IdIndex&) = default;
+		IdIndex& operator= (IdIndex&&) noexcept = default;
+
+		size_t size() const;
+		bool empty() const;
+
+		void insert(const ID& id, Handle handle);
+		bool erase(const ID& id);
+		void clear();
+
+		inline Handle find(const ID& id) const
+		{
+			if (_entries.empty() || !id)
+				return {};
+
+			const size_t mask = _entries.size() - 1;
+			for (size_t i = bucket(id); _entries[i].id; i = (i + 1) & mask)
+				if (_entries[i].id == id)
+					return _entries[i].handle;
+			return {};
+		}
+
+	private:
+		inline size_t bucket(const ID& id) const
+		{
+			return static_cast<size_t>((static_cast<UInt64>(ID::Hash{}(id)) * 0x9E3779B97F4A7C15ULL) >> _shift);
+		}
+
+		void rehash(size_t capacity);
+	};
+
+
+	/* Bytes owned by an object outside of its pool cell, such as texture pixels or audio samples. */
+	template<typename _Ty>
+	struct Footprint
+	{
+		static size_t bytes(const _Ty&) { return 0; }
+	};
+
+	struct AllocationStats
+	{
+		std::string type;
+		size_t live = 0;
+		size_t peak = 0;
+		size_t allocations = 0;
+		size_t frees = 0;
+		size_t cellBytes = 0;
+		size_t reservedBytes = 0;
+		size_t resourceBytes = 0;
+
+		AllocationStats& operator+= (const AllocationStats& right);
+	};
+
+	/* Every live allocator is linked here so the whole process can be inspected at once. */
+	class TrackedAllocator
+	{
+	private:
+		TrackedAllocator* _prev;
+		TrackedAllocator* _next;
+
+		static TrackedAllocator* Head;
+
+	protected:
+		TrackedAllocator();
+		virtual ~TrackedAllocator();
+
+	public:
+		NON_COPYABLE_MOVABLE(TrackedAllocator);
+
+		virtual void collectStats(std::vector<AllocationStats>& stats) const = 0;
+
+		friend std::vector<AllocationStats> collectStats();
+	};
+
+	/* Stats of every live allocator, merged by concrete type. */
+	std::vector<AllocationStats> collectStats();
+
+	void dumpStats(std::ostream& os, const std::vector<AllocationStats>& stats);
+	bool dumpStats(const std::string& filepath);
+
+
 	template<typename _Base>
 	class AllocatorList;
 
+	template<typename _Base>
+	class Pool;
+
 	template<typename _Base>
 	struct Allocator final
 	{
-		AllocatorList<_Base>* const list;
-		_Base* const data;
-		Allocator* next;
-		Allocator* prev;
-
-		Allocator(AllocatorList<_Base>* list, _Base* data) :
-			list{ list },
-			data{ data },
-			next{ nullptr },
-			prev{ nullptr }
+		Pool<_Base>* const pool;
+		_Base* data;
+		Allocator* nextFree;
+		UInt32 slot;
+
+		Allocator(Pool<_Base>* pool) :
+			pool{ pool },
+			data{ nullptr },
+			nextFree{ nullptr },
+			slot{ 0 }
 		{}
-		~Allocator() { delete data; }
 
 		Allocator(const Allocator&) = delete;
 		Allocator& operator= (const Allocator&) = delete;
 	};
+
+
+	template<typename _Base>
+	class PoolIndex final
+	{
+	private:
+		static size_t next()
+		{
+			static size_t counter = 0;
+			return counter++;
+		}
+
+	public:
+		template<typename _Ty>
+		static size_t of()
+		{
+			static const size_t index = next();
+			return index;
+		}
+
+		PoolIndex() = delete;
+	};
+
+
+	/*
+	 * Slab of fixed-size cells for one concrete type. Each cell holds its Allocator
+	 * header followed by the object storage. Freed cells are chained through the
+	 * header, so create and destroy are O(1). Chunks are only released on destruction
+	 * or when compact() packs nothrow-movable objects towards the front of the pool.
+	 * In arena mode freed cells are not reused until the next clear(), which makes the
+	 * pool a monotonic bump allocator: cells stay in creation order and the high-water
+	 * mark sizes the next reserve(). It is a sizing aid, not a faster teardown: clear()
+	 * costs the same in both modes, and memory only grows until then.
+	 */
+	template<typename _Base>
+	class Pool final
+	{
+	public:
+		typedef Allocator<_Base> Node;
+		typedef _Base* (*Relocator)(void*, _Base*);
+		typedef size_t (*FootprintGetter)(const _Base&);
+		typedef void (*Sweeper)(const Pool&);
+
+		static constexpr size_t ChunkBytes = 16 * 1024;
+		static constexpr size_t MinChunkCells = 8;
+
+	private:
+		AllocatorList<_Base>* const _list;
+		const Relocator _relocate;
+		const FootprintGetter _footprint;
+		const Sweeper _destroyAll;
+		const char* const _typeName;
+		const size_t _cellAlign;
+		const size_t _dataOffset;
+		const size_t _cellSize;
+		const size_t _chunkCells;
+
+		std::vector<std::byte*> _chunks;
+		size_t _used;
+		size_t _size;
+		size_t _highWater;
+		size_t _peak;
+		size_t _allocations;
+		size_t _frees;
+		Node* _free;
+		bool _arena;
+
+	public:
+		template<typename _Ty>
+		Pool(AllocatorList<_Base>* list, std::in_place_type_t<_Ty>) :
+			_list{ list },
+			_relocate{ relocatorOf<_Ty>() },
+			_footprint{ &footprintOf<_Ty> },
+			_destroyAll{ &destroyCells<_Ty> },
+			_typeName{ typeid(_Ty).name() },
+			_cellAlign{ std::max(alignof(Node), alignof(_Ty)) },
+			_dataOffset{ roundUp(sizeof(Node), alignof(_Ty)) },
+			_cellSize{ roundUp(_dataOffset + sizeof(_Ty), _cellAlign) },
+			_chunkCells{ std::max(MinChunkCells, ChunkBytes / _cellSize) },
+			_chunks{},
+			_used{ 0 },
+			_size{ 0 },
+			_highWater{ 0 },
+			_peak{ 0 },
+			_allocations{ 0 },
+			_frees{ 0 },
+			_free{ nullptr },
+			_arena{ false }
+		{}
+		~Pool()
+		{
+			clear();
+			for (std::byte* chunk : _chunks)
+				::operator delete(chunk, std::align_val_t{ _cellAlign });
+		}
+
+		NON_COPYABLE_MOVABLE(Pool);
+
+		inline AllocatorList<_Base>* list() const { return _list; }
+
+		inline size_t size() const { return _size; }
+		inline size_t used() const { return _used; }
+		inline size_t capacity() const { return _chunks.size() * _chunkCells; }
+		inline size_t cellSize() const { return _cellSize; }
+		inline bool isRelocatable() const { return _relocate; }
+		inline size_t highWaterMark() const { return _highWater; }
+
+		inline bool isArena() const { return _arena; }
+		inline void setArena(bool enabled) { _arena = enabled; }
+
+		inline Node* cell(size_t index) const
+		{
+			return reinterpret_cast<Node*>(_chunks[index / _chunkCells] + (index % _chunkCells) * _cellSize);
+		}
+
+		inline void* storage(Node* node) const { return reinterpret_cast<std::byte*>(node) + _dataOffset; }
+
+		/*
+		 * Calls action(Node*) on every used cell, free or not, stepping through each chunk
+		 * instead of locating every cell. Cells acquired by the action are visited too.
+		 */
+		template<typename _Func>
+		void forEachCell(_Func&& action) const
+		{
+			for (size_t first = 0; first < _used; first += _chunkCells)
+			{
+				std::byte* const chunk = _chunks[first / _chunkCells];
+				for (size_t i = 0; i < _chunkCells && first + i < _used; i++)
+					action(reinterpret_cast<Node*>(chunk + i * _cellSize));
+			}
+		}
+
+		/* First live cell at or after cell offset of chunk, updating both. Null past the last used cell */
+		Node* seek(size_t& chunk, size_t& offset) const
+		{
+			for (; chunk * _chunkCells < _used; chunk++, offset = 0)
+			{
+				std::byte* const cells = _chunks[chunk];
+				const size_t end = std::min(_chunkCells, _used - chunk * _chunkCells);
+				for (; offset < end; offset++)
+				{
+					Node* node = reinterpret_cast<Node*>(cells + offset * _cellSize);
+					if (node->data)
+						return node;
+				}
+			}
+			return nullptr;
+		}
+
+		Node* acquire()
+		{
+			if (_free)
+			{
+				Node* node = _free;
+				_free = node->nextFree;
+				node->nextFree = nullptr;
+				return node;
+			}
+
+			if (_used == capacity())
+				allocateChunk();
+
+			Node* node = new(cell(_used++)) Node(this);
+			_highWater = std::max(_highWater, _used);
+			return node;
+		}
+
+		void reserve(size_t cells)
+		{
+			while (capacity() < cells)
+				allocateChunk();
+		}
+
+		/* Marks an acquired cell as live once its object has been constructed. */
+		inline void commit(Node* node, _Base* data)
+		{
+			node->data = data;
+			_size++;
+			_allocations++;
+			_peak = std::max(_peak, _size);
+		}
+
+		/* Returns an acquired cell whose construction failed. */
+		inline void discard(Node* node)
+		{
+			if (_arena)
+				return;
+			node->nextFree = _free;
+			_free = node;
+		}
+
+		void release(Node* node)
+		{
+			utils::destruct(*node->data);
+			node->data = nullptr;
+			discard(node);
+			_size--;
+			_frees++;
+		}
+
+		/* Destroys the live objects in one typed sweep and rewinds the pool, keeping its chunks */
+		void clear()
+		{
+			static_assert(std::is_trivially_destructible<Node>::value);
+			if (_size > 0)
+				_destroyAll(*this);
+			_frees += _size;
+			_used = 0;
+			_size = 0;
+			_free = nullptr;
+		}
+
+		/* Moves the live objects into the lowest cells and releases the unused chunks. */
+		bool compact()
+		{
+			if (!_relocate)
+				return false;
+
+			size_t top = _used;
+			for (size_t i = 0; i < top; i++)
+			{
+				Node* dst = cell(i);
+				if (dst->data)
+					continue;
+
+				while (top > i + 1 && !cell(top - 1)->data)
+					top--;
+				if (top <= i + 1)
+					break;
+
+				Node* src = cell(--top);
+				dst->data = _relocate(storage(dst), src->data);
+				dst->slot = src->slot;
+				src->data = nullptr;
+				_list->slotTable().relocate(dst->slot, static_cast<void*>(dst->data), dst);
+			}
+
+			_used = _size;
+			_free = nullptr;
+
+			const size_t needed = (_used + _chunkCells - 1) / _chunkCells;
+			while (_chunks.size() > needed)
+			{
+				::operator delete(_chunks.back(), std::align_val_t{ _cellAlign });
+				_chunks.pop_back();
+			}
+			return true;
+		}
+
+		AllocationStats stats() const
+		{
+			AllocationStats st;
+			st.type = _typeName;
+			st.live = _size;
+			st.peak = _peak;
+			st.allocations = _allocations;
+			st.frees = _frees;
+			st.cellBytes = _size * _cellSize;
+			st.reservedBytes = capacity() * _cellSize;
+			for (size_t i = 0; i < _used; i++)
+			{
+				const Node* node = cell(i);
+				if (node->data)
+					st.resourceBytes += _footprint(*node->data);
+			}
+			return st;
+		}
+
+	private:
+		void allocateChunk()
+		{
+			_chunks.push_back(static_cast<std::byte*>(::operator new(_chunkCells * _cellSize, std::align_val_t{ _cellAlign })));
+		}
+
+		static constexpr size_t roundUp(size_t value, size_t align) { return (value + align - 1) / align * align; }
+
+		template<typename _Ty>
+		static _Base* relocateCell(void* storage, _Base* object)
+		{
+			_Ty* src = static_cast<_Ty*>(object);
+			_Ty* dst = new(storage) _Ty(std::move(*src));
+			utils::destruct(*src);
+			return dst;
+		}
+
+		template<typename _Ty>
+		static size_t footprintOf(const _Base& object) { return Footprint<_Ty>::bytes(static_cast<const _Ty&>(object)); }
+
+		/* Qualified destructor calls skip virtual dispatch, so empty destructors leave no loop at all */
+		template<typename _Ty>
+		static void destroyCells(const Pool& pool)
+		{
+			pool.forEachCell([](Node* node) {
+				if (node->data)
+					static_cast<_Ty*>(node->data)->_Ty::~_Ty();
+			});
+		}
+
+		template<typename _Ty>
+		static constexpr Relocator relocatorOf()
+		{
+			if constexpr (std::is_nothrow_move_constructible<_Ty>::value)
+				return &relocateCell<_Ty>;
+			else return nullptr;
+		}
+	};
 }
 #define ALLOCATOR_FRIENDLY friend memory::Allocator
 
 
+/*
+ * Forward iterator over the live objects of an AllocatorList. It keeps its own
+ * position, so destroying the object it points to only affects that object.
+ * AllocatorIterator<const _Base> is the const_iterator.
+ */
 template<class _Ty>
 class AllocatorIterator
 {
 private:
-	using alloc_t = memory::Allocator<_Ty>*;
-
-	alloc_t& _alloc;
-	bool _end;
+	using base_t = std::remove_const_t<_Ty>;
+	using list_t = memory::AllocatorList<base_t>;
+	using alloc_t = memory::Allocator<base_t>;
 
 public:
-	bool operator== (const AllocatorIterator& it) const { return _end == it._end && _alloc == it._alloc; }
-	bool operator!= (const AllocatorIterator& it) const { return _end != it._end && _alloc != it._alloc; }
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = base_t;
+	using difference_type = std::ptrdiff_t;
+	using pointer = _Ty*;
+	using reference = _Ty&;
 
-	bool operator! () const { return _end; }
-	operator bool() { return !_end; }
+private:
+	const list_t* _list;
+	size_t _pool;
+	size_t _chunk;
+	size_t _offset;
+	alloc_t* _alloc;
 
-	AllocatorIterator operator++ ()
-	{
-		if (_end)
-			throw no_such_element();
+public:
+	AllocatorIterator() :
+		_list{ nullptr },
+		_pool{ 0 },
+		_chunk{ 0 },
+		_offset{ 0 },
+		_alloc{ nullptr }
+	{}
+	AllocatorIterator(const AllocatorIterator&) = default;
+	AllocatorIterator(AllocatorIterator&&) noexcept = default;
+
+	AllocatorIterator& operator= (const AllocatorIterator&) = default;
+	AllocatorIterator& operator= (AllocatorIterator&&) noexcept = default;
+
+	template<class _Other>
+		requires std::is_same<const _Other, _Ty>::value && (!std::is_same<_Other, _Ty>::value)
+	AllocatorIterator(const AllocatorIterator<_Other>& it) :
+		_list{ it._list },
+		_pool{ it._pool },
+		_chunk{ it._chunk },
+		_offset{ it._offset },
+		_alloc{ it._alloc }
+	{}
 
-		if (!_alloc->next)
-			_end = true;
-		else _alloc = _alloc->next;
+	bool operator== (const AllocatorIterator& it) const { return _alloc == it._alloc; }
+	bool operator!= (const AllocatorIterator& it) const { return _alloc != it._alloc; }
 
+	AllocatorIterator& operator++ ()
+	{
+		_offset++;
+		_alloc = _list->seek(_pool, _chunk, _offset);
 		return *this;
 	}
 	AllocatorIterator operator++ (int)
 	{
-		AllocatorIterator old{ _alloc, _end };
+		AllocatorIterator old{ *this };
 		operator++();
 		return old;
 	}
 
-	AllocatorIterator operator-- ()
-	{
-		if (_alloc->prev)
-		{
-			_alloc = _alloc->prev;
-			_end = false;
-		}
-		else throw no_such_element();
+	reference operator* () const { return *_alloc->data; }
+	pointer operator-> () const { return _alloc->data; }
 
-		return *this;
-	}
-	AllocatorIterator operator-- (int)
-	{
-		AllocatorIterator old{ _alloc, _end };
-		operator--();
-		return old;
-	}
-
-	_Ty& operator* ()
-	{
-		return *_alloc->data;
-	}
-	const _Ty& operator* () const
-	{
-		return *_alloc->data;
-	}
-
-	_Ty* operator->()
-	{
-		return _alloc->data;
-	}
-	const _Ty* operator->() const
-	{
-		return _alloc->data;
-	}
-
-	template<class _Ty>
-	friend class memory::AllocatorList;
+	template<class _Other>
+	friend class AllocatorIterator;
 
+	friend class memory::AllocatorList<base_t>;
 
 private:
-	AllocatorIterator(alloc_t& alloc, bool end) : _alloc(alloc), _end(end) {}
-
-public:
-	class no_such_element : public std::exception {};
+	AllocatorIterator(const list_t* list) :
+		_list{ list },
+		_pool{ 0 },
+		_chunk{ 0 },
+		_offset{ 0 },
+		_alloc{ list->seek(_pool, _chunk, _offset) }
+	{}
 };
 
 
 namespace memory
 {
 	template<typename _Base>
-	class AllocatorList
+	class AllocatorList : public TrackedAllocator
 	{
 	public:
 		typedef Allocator<_Base> Node;
 
 	private:
-		Node* _head;
-		Node* _tail;
+		std::vector<Pool<_Base>*> _pools;
+		SlotTable _slots;
 		size_t _size;
+		bool _arena;
 
 	public:
 		AllocatorList() :
-			_head{ nullptr },
-			_tail{ nullptr },
+			TrackedAllocator{},
+			_pools{},
+			_slots{},
 			_size{ 0 },
-			_begin{ _head, false },
-			_end{ _tail, true }
+			_arena{ false }
 		{}
-		~AllocatorList() { clear(); }
+		~AllocatorList()
+		{
+			clear();
+			for (Pool<_Base>* pool : _pools)
+				delete pool;
+		}
+
+		NON_COPYABLE_MOVABLE(AllocatorList);
+
+		inline size_t size() const { return _size; }
+		inline bool empty() const { return _size == 0; }
+
+		inline SlotTable& slotTable() { return _slots; }
+		inline const SlotTable& slotTable() const { return _slots; }
+
+		inline Handle handle(const Node* node) const { return _slots.handle(node->slot); }
 
 		template<typename _Ty, typename... _Args>
 		Node* create(_Args&&... args)
 		{
-			_Base* data = new _Ty(std::forward<_Args>(args)...);
+			static_assert(std::is_base_of<_Base, _Ty>::value);
+			static_assert(std::is_same<_Base, _Ty>::value || std::has_virtual_destructor<_Base>::value);
 
-			if (!_head)
+			Pool<_Base>& pool = getPool<_Ty>();
+			Node* node = pool.acquire();
+			try
+			{
+				pool.commit(node, new(pool.storage(node)) _Ty(std::forward<_Args>(args)...));
+			}
+			catch (...)
 			{
-				_head = new Node(this, data);
-				_tail = _head;
-				_size++;
-				return _head;
+				pool.discard(node);
+				throw;
 			}
-			Node* node = new Node(this, data);
-			node->prev = _tail;
-			_tail->next = node;
-			_tail = node;
+			node->slot = _slots.acquire(static_cast<void*>(node->data), node).index();
 			_size++;
 			return node;
 		}
 
 		void destroy(Node* const& allocator)
 		{
-			if (!_head || allocator->list != this)
+			if (!allocator || !allocator->data || allocator->pool->list() != this)
 				return;
 
-			Node* current = allocator;
+			_slots.release(allocator->slot);
+			allocator->pool->release(allocator);
+			_size--;
+		}
 
-			if (_head == _tail)
-			{
-				delete _head;
-				_head = nullptr;
-				_tail = nullptr;
-				_size = 0;
-			}
-			else
-			{
-				Node* prev = current->prev;
-				Node* next = current->next;
+		void clear()
+		{
+			for (Pool<_Base>* pool : _pools)
+				if (pool)
+					pool->clear();
+			_slots.clear();
+			_size = 0;
+		}
+
+		void compact()
+		{
+			for (Pool<_Base>* pool : _pools)
+				if (pool)
+					pool->compact();
+		}
+
+		inline bool isArena() const { return _arena; }
+		void setArena(bool enabled)
+		{
+			_arena = enabled;
+			for (Pool<_Base>* pool : _pools)
+				if (pool)
+					pool->setArena(enabled);
+		}
 
-				if (current == _head)
-					_head = _head->next;
-				if (current == _tail)
-					_tail = _tail->prev;
+		template<typename _Ty>
+		inline void reserve(size_t count) { getPool<_Ty>().reserve(count); }
 
-				prev->next = next;
-				next->prev = prev;
-				_size--;
+		size_t highWaterMark() const
+		{
+			size_t cells = 0;
+			for (const Pool<_Base>* pool : _pools)
+				if (pool)
+					cells += pool->highWaterMark();
+			return cells;
+		}
 
-				delete current;
-			}
+		size_t highWaterBytes() const
+		{
+			size_t bytes = 0;
+			for (const Pool<_Base>* pool : _pools)
+				if (pool)
+					bytes += pool->highWaterMark() * pool->cellSize();
+			return bytes;
 		}
 
-		void clear()
+		void collectStats(std::vector<AllocationStats>& stats) const override
+		{
+			for (const Pool<_Base>* pool : _pools)
+				if (pool)
+					stats.push_back(pool->stats());
+		}
+
+		/* Visits every live node. New pools or chunks created by the action are also visited. */
+		template<typename _Func>
+		void forEachNode(_Func&& action) const
 		{
-			Node* current = _head;
-			while (current)
+			for (size_t p = 0; p < _pools.size(); p++)
 			{
-				Node* next = current->next;
-				delete current;
-				current = next;
+				const Pool<_Base>* pool = _pools[p];
+				if (!pool)
+					continue;
+
+				pool->forEachCell([&action](Node* node) {
+					if (node->data)
+						action(node);
+				});
 			}
-			_head = nullptr;
-			_tail = nullptr;
-			_size = 0;
 		}
 
-		void forEach(std::function<void(_Base&)> action)
+		template<typename _Func>
+		inline void forEach(_Func&& action)
 		{
-			for (Node* current = _head; current; current = current->next)
-				action(current->data);
+			forEachNode([&action](Node* node) { action(*node->data); });
 		}
 
-		void forEach(std::function<void(const _Base&)> action) const
+		template<typename _Func>
+		inline void forEach(_Func&& action) const
 		{
-			for (Node* current = _head; current; current = current->next)
-				action(current->data);
+			forEachNode([&action](const Node* node) { action(static_cast<const _Base&>(*node->data)); });
 		}
 
+		/* Visits the objects whose concrete type is exactly _Ty, in cell order. */
+		template<typename _Ty, typename _Func>
+		void forEachOfType(_Func&& action)
+		{
+			static_assert(std::is_base_of<_Base, _Ty>::value);
+			const size_t index = PoolIndex<_Base>::template of<_Ty>();
+			if (index >= _pools.size() || !_pools[index])
+				return;
+
+			_pools[index]->forEachCell([&action](Node* node) {
+				if (node->data)
+					action(*static_cast<_Ty*>(node->data));
+			});
+		}
+
+		template<typename _Ty, typename _Func>
+		inline void forEachOfType(_Func&& action) const
+		{
+			const_cast<AllocatorList*>(this)->template forEachOfType<_Ty>([&action](const _Ty& obj) { action(obj); });
+		}
+
+		template<typename _Ty>
+		inline size_t countOfType() const
+		{
+			const size_t index = PoolIndex<_Base>::template of<_Ty>();
+			return index < _pools.size() && _pools[index] ? _pools[index]->size() : 0;
+		}
+
+		/* Finds the first live cell at or after (pool, chunk, offset), updating all three. */
+		Node* seek(size_t& pool, size_t& chunk, size_t& offset) const
+		{
+			for (; pool < _pools.size(); pool++, chunk = 0, offset = 0)
+			{
+				const Pool<_Base>* p = _pools[pool];
+				if (!p)
+					continue;
+
+				if (Node* node = p->seek(chunk, offset))
+					return node;
+			}
+			return nullptr;
+		}
 
-		/* Iterable part */
 	private:
-		AllocatorIterator<_Base> _begin;
-		AllocatorIterator<_Base> _end;
+		template<typename _Ty>
+		Pool<_Base>& getPool()
+		{
+			const size_t index = PoolIndex<_Base>::template of<_Ty>();
+			if (index >= _pools.size())
+				_pools.resize(index + 1, nullptr);
+
+			Pool<_Base>*& pool = _pools[index];
+			if (!pool)
+			{
+				pool = new Pool<_Base>(this, std::in_place_type<_Ty>);
+				pool->setArena(_arena);
+			}
+			return *pool;
+		}
+
 
+		/* Iterable part */
 	public:
-		AllocatorIterator<_Base> begin() { return _begin; }
-		const AllocatorIterator<_Base> begin() const { return _begin; }
-		AllocatorIterator<_Base> end() { return _end; }
-		const AllocatorIterator<_Base> end() const { return _end; }
+		AllocatorIterator<_Base> begin() { return { this }; }
+		AllocatorIterator<const _Base> begin() const { return { this }; }
+		AllocatorIterator<_Base> end() { return {}; }
+		AllocatorIterator<const _Base> end() const { return {}; }
 	};
 }
 
 
 
-template<typename _Base>
+template<typename _Base, bool _Indexed>
 class MemoryAllocator;
 
-template<typename _Ty>
+/*
+ * Generational handle to an object owned by a MemoryAllocator. A Ref stays 8 bytes
+ * wide, survives relocation of its object and turns null once the object is freed.
+ * _Base is the base type of the owning allocator: slots hold _Base pointers, so they
+ * are cast back to _Base before moving to _Ty, whatever the offset between the two.
+ */
+template<typename _Ty, typename _Base = _Ty>
 class Ref final
 {
+	static_assert(std::is_base_of<_Base, _Ty>::value);
+
 private:
-	_Ty* _ptr;
-	void* _alloc;
+	memory::Handle _handle;
 
 public:
-	template<typename _Base>
-	Ref(memory::Allocator<_Base>& alloc) :
-		_ptr{ reinterpret_cast<_Ty*>(alloc.data) },
-		_alloc{ reinterpret_cast<void*>(&alloc) }
-	{
-		static_assert(std::is_base_of<_Base, _Ty>::value);
-	}
 	Ref() :
-		_ptr{ nullptr },
-		_alloc{ nullptr }
+		_handle{}
 	{}
 	Ref(decltype(nullptr)) :
-		_ptr{ nullptr },
-		_alloc{ nullptr }
+		_handle{}
 	{}
 	Ref(const Ref&) = default;
 	Ref(Ref&&) = default;
@@ -365,108 +1004,230 @@ public:
 	Ref& operator= (const Ref&) = default;
 	Ref& operator= (Ref&&) = default;
 
-	operator bool() const { return _ptr; }
-	bool operator! () const { return !_ptr; }
+	operator bool() const { return get(); }
+	bool operator! () const { return !get(); }
 	
-	bool operator== (const Ref& right) const { return _ptr == right._ptr; }
-	bool operator!= (const Ref& right) const { return _ptr != right._ptr; }
-	bool operator> (const Ref& right) const { return _ptr > right._ptr; }
-	bool operator< (const Ref& right) const { return _ptr < right._ptr; }
-	bool operator>= (const Ref& right) const { return _ptr >= right._ptr; }
-	bool operator<= (const Ref& right) const { return _ptr <= right._ptr; }
+	bool operator== (const Ref& right) const { return _handle == right._handle; }
+	bool operator!= (const Ref& right) const { return _handle != right._handle; }
+	bool operator> (const Ref& right) const { return _handle > right._handle; }
+	bool operator< (const Ref& right) const { return _handle < right._handle; }
+	bool operator>= (const Ref& right) const { return _handle >= right._handle; }
+	bool operator<= (const Ref& right) const { return _handle <= right._handle; }
+
+	_Ty& operator* () { return *get(); }
+	const _Ty& operator* () const { return *get(); }
 
-	_Ty& operator* () { return *_ptr; }
-	const _Ty& operator* () const { return *_ptr; }
+	_Ty* operator& () { return get(); }
+	const _Ty* operator& () const { return get(); }
 
-	_Ty* operator& () { return _ptr; }
-	const _Ty* operator& () const { return _ptr; }
+	_Ty* operator->() { return get(); }
+	const _Ty* operator->() const { return get(); }
 
-	_Ty* operator->() { return _ptr; }
-	const _Ty* operator->() const { return _ptr; }
+	memory::Handle handle() const { return _handle; }
 
 private:
-	explicit Ref(_Ty* ptr, void* alloc) :
-		_ptr{ ptr },
-		_alloc{ alloc }
+	explicit Ref(memory::Handle handle) :
+		_handle{ handle }
 	{}
 
+	inline _Ty* get() const
+	{
+		const memory::SlotTable::Slot* slot = memory::SlotTable::resolve(_handle);
+		return slot ? static_cast<_Ty*>(static_cast<_Base*>(slot->data)) : nullptr;
+	}
+
 public:
-	template<typename _Base>
-	static Ref<_Ty> downcast(Ref<_Base>& ref)
+	/* Null unless the object is a _Ty */
+	template<typename _Super>
+	static Ref downcast(const Ref<_Super, _Base>& ref)
 	{
-		static_assert(std::is_base_of<_Base, _Ty>::value);
-		return Ref<_Ty>(dynamic_cast<_Ty*>(ref._ptr), ref._alloc);
+		static_assert(std::is_base_of<_Super, _Ty>::value);
+		return dynamic_cast<_Ty*>(ref.get()) ? Ref(ref._handle) : Ref();
 	}
 
 	template<typename _Sub>
-	static Ref<_Ty> upcast(Ref<_Sub>& ref)
+	static Ref upcast(const Ref<_Sub, _Base>& ref)
 	{
 		static_assert(std::is_base_of<_Ty, _Sub>::value);
-		return Ref<_Ty>(reinterpret_cast<_Ty*>(ref._ptr), ref._alloc);
+		return Ref(ref._handle);
 	}
 
-	template<typename _Base>
+	template<typename _Other, typename _OtherBase>
+	friend class Ref;
+
+	template<typename _Owner, bool _Indexed>
 	friend class MemoryAllocator;
 };
 
 
 
-template<typename _Base>
+/*
+ * Owner of objects of _Base and its subtypes, grouped in one pool per concrete type.
+ * With _Indexed the objects, which must derive from Object, are also indexed by ID on
+ * create and destroy for findById() and contains(); others pay nothing for it.
+ * Allocation, destruction and Ref resolution are not synchronized: an allocator and
+ * the Refs into it must only be used from one thread at a time.
+ */
+template<typename _Base, bool _Indexed = false>
 class MemoryAllocator
 {
 public:
 	using alloc_t = memory::Allocator<_Base>;
 	using iterator = AllocatorIterator<_Base>;
-	using const_iterator = const AllocatorIterator<_Base>;
+	using const_iterator = AllocatorIterator<const _Base>;
+
+	static constexpr bool Indexed = _Indexed;
+	static_assert(!Indexed || std::is_base_of<Object, _Base>::value, "only Object types can be indexed by ID");
 
 private:
 	memory::AllocatorList<_Base> _mem;
+	memory::IdIndex _ids;
 
 public:
 	MemoryAllocator() :
-		_mem{}
+		_mem{},
+		_ids{}
 	{}
 	~MemoryAllocator() {}
 
 	template<typename _Ty, typename... _Args>
-	Ref<_Ty> alloc(_Args&&... args)
+	Ref<_Ty, _Base> alloc(_Args&&... args)
 	{
 		static_assert(std::is_base_of<_Base, _Ty>::value);
-		return Ref<_Ty>(*_mem.create<_Ty>(std::forward<_Args>(args)...));
+		alloc_t* node = _mem.template create<_Ty>(std::forward<_Args>(args)...);
+		const memory::Handle handle = _mem.handle(node);
+		if constexpr (Indexed)
+			_ids.insert(node->data->id(), handle);
+		return Ref<_Ty, _Base>(handle);
 	}
 
 	template<typename _Ty>
-	inline void free(Ref<_Ty> ptr)
+	inline void free(const Ref<_Ty, _Base>& ptr)
 	{
 		static_assert(std::is_base_of<_Base, _Ty>::value);
-		_mem.destroy(reinterpret_cast<memory::Allocator<_Base>*>(ptr._alloc));
+		if (ptr._handle.table() != _mem.slotTable().id())
+			return;
+
+		const memory::SlotTable::Slot* slot = memory::SlotTable::resolve(ptr._handle);
+		if (slot)
+		{
+			alloc_t* node = static_cast<alloc_t*>(slot->node);
+			if constexpr (Indexed)
+				_ids.erase(node->data->id());
+			_mem.destroy(node);
+		}
+	}
+
+	template<typename _Ty>
+	void free(const std::vector<Ref<_Ty, _Base>>& ptrs)
+	{
+		static_assert(std::is_base_of<_Base, _Ty>::value);
+		const UInt32 table = _mem.slotTable().id();
+		for (const Ref<_Ty, _Base>& ptr : ptrs)
+		{
+			if (ptr._handle.table() != table)
+				continue;
+
+			const memory::SlotTable::Slot* slot = memory::SlotTable::resolve(ptr._handle);
+			if (slot)
+			{
+				alloc_t* node = static_cast<alloc_t*>(slot->node);
+				if constexpr (Indexed)
+					_ids.erase(node->data->id());
+				_mem.destroy(node);
+			}
+		}
 	}
 
 	inline void clear()
 	{
 		_mem.clear();
+		_ids.clear();
 	}
 
-	std::vector<Ref<_Base>> find(std::function<bool(const _Base&)> criteria)
+	template<typename _Ty = _Base>
+	Ref<_Ty, _Base> findById(const ID& id) const
 	{
-		std::vector<Ref<_Base>> vec;
-		for (alloc_t* alloc = _mem._head; alloc; alloc = alloc->next)
-			if (criteria(alloc->data))
-				vec.push_back({ alloc });
-		return std::move(vec);
+		static_assert(Indexed);
+		static_assert(std::is_base_of<_Base, _Ty>::value);
+
+		Ref<_Base> ref{ _ids.find(id) };
+		if constexpr (std::is_same<_Base, _Ty>::value)
+			return ref;
+		else return Ref<_Ty, _Base>::downcast(ref);
 	}
 
-	const std::vector<Ref<_Base>> find(std::function<bool(const _Base&)> criteria) const
+	inline bool contains(const ID& id) const
+	{
+		static_assert(Indexed);
+		return !_ids.find(id).isNull();
+	}
+
+	/* Packs relocatable objects into fewer chunks. Outstanding Refs remain valid. */
+	inline void compact()
+	{
+		_mem.compact();
+	}
+
+	/* Arena mode never reuses freed cells: memory is reclaimed in bulk by clear(). */
+	inline bool isArenaMode() const { return _mem.isArena(); }
+	inline void setArenaMode(bool enabled) { _mem.setArena(enabled); }
+
+	template<typename _Ty>
+	inline void reserve(size_t count)
+	{
+		static_assert(std::is_base_of<_Base, _Ty>::value);
+		_mem.template reserve<_Ty>(count);
+	}
+
+	inline size_t highWaterMark() const { return _mem.highWaterMark(); }
+	inline size_t highWaterBytes() const { return _mem.highWaterBytes(); }
+
+	std::vector<memory::AllocationStats> stats() const
+	{
+		std::vector<memory::AllocationStats> vec;
+		_mem.collectStats(vec);
+		return vec;
+	}
+
+	inline size_t size() const { return _mem.size(); }
+	inline bool empty() const { return _mem.empty(); }
+
+	template<typename _Pred>
+	std::vector<Ref<_Base>> find(_Pred&& criteria) const
 	{
 		std::vector<Ref<_Base>> vec;
-		for (alloc_t* alloc = _mem._head; alloc; alloc = alloc->next)
-			if (criteria(alloc->data))
-				vec.push_back({ alloc });
-		return std::move(vec);
+		_mem.forEachNode([this, &criteria, &vec](const alloc_t* alloc) {
+			if (criteria(static_cast<const _Base&>(*alloc->data)))
+				vec.push_back(Ref<_Base>(_mem.handle(alloc)));
+		});
+		return vec;
+	}
+
+	template<typename _Pred>
+	Ref<_Base> findFirst(_Pred&& criteria) const
+	{
+		size_t pool = 0, chunk = 0, offset = 0;
+		for (const alloc_t* alloc = _mem.seek(pool, chunk, offset); alloc; alloc = _mem.seek(pool, chunk, ++offset))
+			if (criteria(static_cast<const _Base&>(*alloc->data)))
+				return Ref<_Base>(_mem.handle(alloc));
+		return nullptr;
 	}
 
-	inline void forEach(std::function<void(_Base&)> action) { _mem.forEach(action); }
-	inline void forEach(std::function<void(const _Base&)> action) const { _mem.forEach(action); }
+	template<typename _Func>
+	inline void forEach(_Func&& action) { _mem.forEach(std::forward<_Func>(action)); }
+
+	template<typename _Func>
+	inline void forEach(_Func&& action) const { _mem.forEach(std::forward<_Func>(action)); }
+
+	template<typename _Ty, typename _Func>
+	inline void forEachOfType(_Func&& action) { _mem.template forEachOfType<_Ty>(std::forward<_Func>(action)); }
+
+	template<typename _Ty, typename _Func>
+	inline void forEachOfType(_Func&& action) const { _mem.template forEachOfType<_Ty>(std::forward<_Func>(action)); }
+
+	template<typename _Ty>
+	inline size_t countOfType() const { return _mem.template countOfType<_Ty>(); }
 
 	/*template<typename _Ty>
 	inline Ref<_Ty> operator[] (const ID& id) 
@@ -146,6 +146,7 @@ PYBIND11_EMBEDDED_MODULE(BPS, m) {
 	model.def_readwrite("localStrings", &BubbleModel::localStrings);
 
 	model.def_readwrite("init", &BubbleModel::init);
+	model.def_readwrite("initBatch", &BubbleModel::initBatch);
 
 	model.def_readwrite("onCollide", &BubbleModel::onCollide);
 	model.def_readwrite("onInserted", &BubbleModel::onInserted);
@@ -247,6 +248,16 @@ PYBIND11_EMBEDDED_MODULE(BPS, m) {
 
 
 
+	/* BubbleBatch */
+	py::class_<BubbleBatch> bb{ m, "BubbleBatch" };
+
+	bb.def("__len__", &BubbleBatch::size);
+	bb.def("getBubble", &BubbleBatch::getBubble, py::return_value_policy::reference);
+	bb.def("getColor", &BubbleBatch::getColor);
+	bb.def("isEditorMode", &BubbleBatch::isEditorMode);
+
+
+
 	/* ColorType */
 	py::enum_<BubbleColorType> ct{ m, "BubbleColorType" };
 	ct.value("Colorless", BubbleColorType::Colorless);
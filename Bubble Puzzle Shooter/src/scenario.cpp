@@ -3,8 +3,7 @@
 
 BubbleColorSelector::BubbleColorSelector(const RNG& rand) :
 	_rand{ rand },
-	_colors{},
-	_map{}
+	_colors{}
 {}
 BubbleColorSelector::~BubbleColorSelector() {}
 
@@ -20,16 +19,27 @@ void BubbleColorSelector::setAvailableColor(const BubbleColor& color, bool enabl
 const BubbleColor& BubbleColorSelector::select()
 {
 	static const auto defaultColor = BubbleColor::defaultColor();
-	return _map.empty()
-		? defaultColor
-		: _map[_rand(0, static_cast<RNG::RandomValue>(_map.size()))];
+	return _colors ? pick(_colors) : defaultColor;
 }
 
-void BubbleColorSelector::updateMap()
+const BubbleColor& BubbleColorSelector::select(BubbleColor::Mask filter)
 {
-	_map.clear();
-	for (const auto& color : BubbleColor::all())
-		_map.push_back(color);
+	const BubbleColor::Mask colors = _colors & filter;
+	if (!colors)
+		return select();
+
+	return pick(colors);
+}
+
+const BubbleColor& BubbleColorSelector::pick(BubbleColor::Mask colors)
+{
+	/* all() is in bit order, so the n-th set bit of the mask indexes it directly */
+	static const auto all = BubbleColor::all();
+
+	UInt32 bits = colors;
+	for (auto nth = _rand(0, static_cast<RNG::RandomValue>(std::popcount(bits))); nth > 0; nth--)
+		bits &= bits - 1;
+	return all[std::countr_zero(bits)];
 }
 
 
@@ -39,6 +49,11 @@ void BubbleColorSelector::updateMap()
 
 void BubbleGenerator::setup(LevelProperties& props)
 {
+	_heap.reset();
+	_heap.setArenaMode(props.isArenaBubblesEnabled() && !utils::isEndless(props.getHiddenBubbleContainerType()));
+	_heap.reserve(static_cast<size_t>(props.getBubbleBoardCount() * utils::VisibleRows + props.getInitialFilledRows()) *
+		utils::styleToColumn(props.getColuns()));
+
 	_colors.setRand(props.generateRNG());
 	_arrowRand = props.generateRNG();
 	_boardRand = props.generateRNG();
@@ -59,211 +74,242 @@ RandomBubbleModelSelector& BubbleGenerator::getModelSelector(bool arrow) { retur
 
 const BubbleColor& BubbleGenerator::getLastColor() const { return _lastColor; }
 
+const BubbleHeap& BubbleGenerator::getHeap() const { return _heap; }
+BubbleHeap& BubbleGenerator::getHeap() { return _heap; }
+
 RNG& BubbleGenerator::rand(bool arrow) { return arrow ? _arrowRand : _boardRand; }
 
 Ref<Bubble> BubbleGenerator::generateFromIdentifier(const BubbleIdentifier& id, TextureManager& textures)
 {
 	if (id.color().isRandom())
-		return _heap.create(id.model(), textures, false, _colors.select());
+		return _heap.create(BubbleModelManager::getModel(id.modelId()), textures, false, _colors.select());
 	return _heap.create(id, textures, false);
 }
 
+Ref<Bubble> BubbleGenerator::generateArrowBubble(const BubbleBoard& board, TextureManager& textures)
+{
+	const Ref<BubbleModel> model = _arrowModels.selectModel(rand(true));
+	if (!model)
+		return nullptr;
 
+	_lastColor = model->onlyBoardColorInArrowGen ? _colors.select(board.getPresentColors()) : _colors.select();
+	return _heap.create(model, textures, false, _lastColor);
+}
+
+std::vector<Ref<Bubble>> BubbleGenerator::generateFromIdentifiers(std::span<const BubbleIdentifier> ids, TextureManager& textures)
+{
+	std::vector<BubbleIdentifier> resolved{ ids.begin(), ids.end() };
+	for (BubbleIdentifier& id : resolved)
+		if (id && id.color().isRandom())
+			id.color(_colors.select());
+	return _heap.createBatch(resolved, textures, false);
+}
 
 
 
 
-HiddenBubbleContainer::HiddenRow::HiddenRow(const std::vector<BubbleIdentifier>& bubbles) :
-	_bubbles{ bubbles },
-	_count{ -1 }
-{}
 
-HiddenBubbleContainer::HiddenRow::operator bool() const { return !_bubbles.empty(); }
-bool HiddenBubbleContainer::HiddenRow::operator! () const { return _bubbles.empty(); }
 
-bool HiddenBubbleContainer::HiddenRow::empty() const { return _bubbles.empty(); }
+HiddenBubbleContainer::operator bool() const { return !empty(); }
+bool HiddenBubbleContainer::operator! () const { return empty(); }
 
-const std::vector<BubbleIdentifier>& HiddenBubbleContainer::HiddenRow::getBubbles() const { return _bubbles; }
-void HiddenBubbleContainer::HiddenRow::setBubbles(const std::vector<BubbleIdentifier>& bubbles)
+bool HiddenBubbleContainer::empty() const { return _rows == 0 && _ready.empty(); }
+bool HiddenBubbleContainer::isDiscrete() const { return utils::isDiscrete(_type); }
+
+void HiddenBubbleContainer::setup(LevelProperties& props)
 {
-	_bubbles = bubbles;
-	_count = -1;
+	_source = nullptr;
+	_view = {};
+	_order.clear();
+	_board = 0;
+	_row = 0;
+	_rows = 0;
+	_ready.clear();
+	_columns = props.getColuns();
+	_type = props.getHiddenBubbleContainerType();
+	_rand = props.generateRNG();
 }
 
-UInt8 HiddenBubbleContainer::HiddenRow::getValidBubbleCount() const
+void HiddenBubbleContainer::fill(const std::vector<BinaryBubbleBoard>& boards)
 {
-	if (_count < 0)
-	{
-		Int8 ct = 0;
-		for (const auto& bid : _bubbles)
-			if (bid)
-				ct++;
-		const_cast<HiddenRow*>(this)->_count = ct;
-	}
-	return _count;
+	_source = &boards;
+	_view = {};
+	_ready.clear();
+	restart();
 }
-
-std::vector<Ref<Bubble>> HiddenBubbleContainer::HiddenRow::generate(BubbleHeap& heap, TextureManager& textures) const
+void HiddenBubbleContainer::fill(const LevelView& level)
 {
-	if (!_bubbles.empty())
-	{
-		std::vector<Ref<Bubble>> bubs{ _bubbles.size() };
-		for (const auto& bid : _bubbles)
-		{
-			bubs.push_back(heap.create(bid, textures, false));
-		}
-		return bubs;
-	}
-	return {};
+	_source = nullptr;
+	_view = level;
+	_ready.clear();
+	if (level)
+		_columns = level.getColumns();
+	restart();
 }
 
+std::vector<std::vector<Ref<Bubble>>> HiddenBubbleContainer::generate(BubbleGenerator& bgen, TextureManager& textures)
+{
+	if (utils::isDiscrete(_type))
+		return generateBoard(bgen, textures);
 
+	std::vector<std::vector<Ref<Bubble>>> rows;
+	if (!empty())
+		rows.push_back(generateRow(bgen, textures));
+	return rows;
+}
 
-
-HiddenBubbleContainer::HiddenBoard::operator bool() const { return !_rows.empty(); }
-bool HiddenBubbleContainer::HiddenBoard::operator! () const { return _rows.empty(); }
-
-bool HiddenBubbleContainer::HiddenBoard::empty() const { return _rows.empty(); }
-
-UInt32 HiddenBubbleContainer::HiddenBoard::getValidBubbleCount() const
+std::vector<std::vector<Ref<Bubble>>> HiddenBubbleContainer::generateBoard(BubbleGenerator& bgen, TextureManager& textures)
 {
-	if (_modified)
+	std::vector<std::vector<Ref<Bubble>>> rows;
+	bool boardEnd = false;
+	while (!boardEnd && !_ready.empty())
 	{
-		UInt32 count = 0;
-		for (const auto& row : _rows)
-			count += static_cast<UInt32>(row.getValidBubbleCount());
-		const_cast<HiddenBoard*>(this)->_count = count;
-		const_cast<HiddenBoard*>(this)->_modified = false;
+		rows.push_back(std::move(_ready.front().bubbles));
+		boardEnd = _ready.front().boardEnd;
+		_ready.pop_front();
 	}
-	return _count;
-}
 
-void HiddenBubbleContainer::HiddenBoard::trimTop()
-{
-	while (!_rows.empty() && _rows.back().empty())
-		_rows.pop_back();
+	/* An endless container starts the next pass as soon as the board ends */
+	while (!boardEnd && _rows > 0)
+		rows.push_back(decodeRow(bgen, textures, boardEnd));
+	return rows;
 }
 
-void HiddenBubbleContainer::HiddenBoard::addRow(const std::vector<BubbleIdentifier>& bubbles)
+std::vector<Ref<Bubble>> HiddenBubbleContainer::generateRow(BubbleGenerator& bgen, TextureManager& textures)
 {
-	if (_rows.size() < utils::VisibleRows)
+	if (!_ready.empty())
 	{
-		_modified = true;
-		_rows.emplace_back(bubbles);
+		std::vector<Ref<Bubble>> row = std::move(_ready.front().bubbles);
+		_ready.pop_front();
+		return row;
 	}
+
+	bool boardEnd;
+	return decodeRow(bgen, textures, boardEnd);
 }
 
-std::vector<Ref<Bubble>> HiddenBubbleContainer::HiddenBoard::extractGeneratedRow(BubbleHeap& heap, TextureManager& textures)
+UInt32 HiddenBubbleContainer::getValidBubbleCount() const
 {
-	if (!_rows.empty())
+	UInt32 count = 0;
+	const auto countRows = [this, &count](UInt32 board, Row first, Row last) {
+		for (Row row = first; row <= last; row++)
+			for (Column column = 0; column < utils::adaptIfIsOdd(row, _columns); column++)
+				if (peekBubble(board, row, column))
+					count++;
+	};
+
+	if (_rows > 0)
 	{
-		_modified = true;
-		auto row = _rows.front().generate(heap, textures);
-		_rows.pop_front();
-		return row;
+		countRows(_order[_board], _row + 1 - _rows, _row);
+		for (UInt32 i = _board + 1; i < _order.size(); i++)
+			countRows(_order[i], getFirstRow(i), utils::VisibleRows - 1);
 	}
-	return {};
+
+	for (const ReadyRow& row : _ready)
+		for (const Ref<Bubble>& bubble : row.bubbles)
+			if (bubble)
+				count++;
+	return count;
 }
-std::vector<std::vector<Ref<Bubble>>> HiddenBubbleContainer::HiddenBoard::extractAllGeneratedRows(BubbleHeap& heap, TextureManager& textures)
+
+void HiddenBubbleContainer::prepare(BubbleGenerator& bgen, TextureManager& textures, UInt32 maxRows)
 {
-	if (!_rows.empty())
+	for (; maxRows > 0 && _rows > 0 && _ready.size() < _readyDepth; maxRows--)
 	{
-		std::vector<std::vector<Ref<Bubble>>> board{ _rows.size() };
-		_modified = true;
-		for (const auto& hrow : _rows)
-			board.push_back(hrow.generate(heap, textures));
-		_rows.clear();
-		return board;
+		bool boardEnd;
+		std::vector<Ref<Bubble>> bubbles = decodeRow(bgen, textures, boardEnd);
+		_ready.push_back({ std::move(bubbles), boardEnd });
 	}
-	return {};
 }
 
+UInt32 HiddenBubbleContainer::getReadyDepth() const { return _readyDepth; }
+void HiddenBubbleContainer::setReadyDepth(UInt32 rows) { _readyDepth = rows; }
 
+UInt32 HiddenBubbleContainer::getReadyRowCount() const { return static_cast<UInt32>(_ready.size()); }
 
-
-
-
-
-HiddenBubbleContainer::operator bool() const { return !_boards.empty() || (_current && !_current->empty()); }
-bool HiddenBubbleContainer::operator! () const { return _boards.empty() && (!_current || _current->empty()); }
-
-bool HiddenBubbleContainer::empty() const { return _boards.empty() && (!_current || _current->empty()); }
-bool HiddenBubbleContainer::isDiscrete() const { return utils::isDiscrete(_type); }
-
-void HiddenBubbleContainer::setup(LevelProperties& props)
+std::vector<Ref<Bubble>> HiddenBubbleContainer::decodeRow(BubbleGenerator& bgen, TextureManager& textures, bool& boardEnd)
 {
-	_boards.clear();
-	_current = nullptr;
-	_columns = props.getColuns();
-	_type = props.getHiddenBubbleContainerType();
-	_rand = props.generateRNG();
+	boardEnd = true;
+	if (_rows == 0)
+		return {};
+
+	const UInt32 board = _order[_board];
+	const Column columns = utils::adaptIfIsOdd(_row, _columns);
+	BubbleIdentifier ids[utils::MaxColumnCount];
+	for (Column column = 0; column < columns; column++)
+		ids[column] = peekBubble(board, _row, column);
+	std::vector<Ref<Bubble>> row = bgen.generateFromIdentifiers({ ids, columns }, textures);
+
+	_row--;
+	_rows--;
+	boardEnd = _rows == 0;
+	checkNext();
+	return row;
 }
 
-void HiddenBubbleContainer::fill(const std::vector<BinaryBubbleBoard>& bin)
+void HiddenBubbleContainer::restart()
 {
-	_boards.clear();
-	_current = nullptr;
-	if (bin.empty())
-		return;
-
-	std::vector<HiddenBoard> aux;
-	for (const auto& bbb : bin)
-		addHiddenBoard(aux, bbb);
-
-	if (!utils::isDiscrete(_type) && aux.size() > 1)
-		aux.back().trimTop();
+	_order.resize(static_cast<size_t>(getBoardCount()));
+	for (UInt32 i = 0; i < _order.size(); i++)
+		_order[i] = i;
 
 	if (utils::isRandom(_type))
 	{
-		while (!aux.empty())
-		{
-			RNG::RandomValue idx = _rand(aux.size());
-			auto it = aux.begin() + idx;
-			_boards.push_back(std::move(*it));
-			aux.erase(it);
-		}
+		for (UInt32 i = static_cast<UInt32>(_order.size()); i > 1; i--)
+			std::swap(_order[i - 1], _order[_rand(0, i)]);
 	}
-	else for (auto& board : aux)
-		_boards.push_back(std::move(board));
-}
-
-std::vector<std::vector<Ref<Bubble>>> HiddenBubbleContainer::generate(BubbleGenerator& bgen, TextureManager& textures);
-
-std::vector<std::vector<Ref<Bubble>>> HiddenBubbleContainer::generateBoard(BubbleGenerator& bgen, TextureManager& textures);
 
-std::vector<Ref<Bubble>> HiddenBubbleContainer::generateRow(BubbleGenerator& bgen, TextureManager& textures);
+	_rows = 0;
+	if (!_order.empty())
+		enterBoard(0);
+	checkNext();
+}
 
-UInt32 HiddenBubbleContainer::getValidBubbleCount() const
+void HiddenBubbleContainer::enterBoard(UInt32 orderIndex)
 {
-	UInt32 count = 0;
-	for (const auto& board : _boards)
-		count += board.getValidBubbleCount();
-	return count;
+	_board = orderIndex;
+	_row = utils::VisibleRows - 1;
+	_rows = utils::VisibleRows - getFirstRow(orderIndex);
 }
 
 void HiddenBubbleContainer::checkNext()
 {
-	if (!_current || _current->empty())
+	while (_rows == 0 && !_order.empty())
 	{
-		const auto& board = 
+		if (_board + 1 < _order.size())
+			enterBoard(_board + 1);
+		else if (utils::isEndless(_type))
+			restart();
+		else return;
 	}
 }
-void HiddenBubbleContainer::addHiddenBoard(std::vector<HiddenBoard>& aux, const BinaryBubbleBoard& bbb)
+
+UInt32 HiddenBubbleContainer::getBoardCount() const
 {
-	HiddenBoard board;
-	for (Row row = utils::VisibleRows - 1; row >= 0; row--)
-		addHiddenRow(board, bbb[row], row);
-	aux.push_back(std::move(board));
+	if (_view)
+		return _view.getBubbleBoardCount();
+	return _source ? static_cast<UInt32>(_source->size()) : 0U;
 }
-void HiddenBubbleContainer::addHiddenRow(HiddenBoard& board, const std::vector<BubbleIdentifier>& brow, Row row)
+
+Row HiddenBubbleContainer::getFirstRow(UInt32 orderIndex) const
 {
-	Column columns = utils::adaptIfIsOdd(row, _columns);
-	std::vector<BubbleIdentifier> ids{ columns };
-	for (Column c = 0; c < columns; c++)
-	{
-		if (c >= brow.size())
-			ids.push_back(BubbleIdentifier::invalid());
-		else ids.push_back(brow[c]);
-	}
-	board.addRow(ids);
+	/* The empty top of the last board of a continuous level never descends */
+	if (utils::isDiscrete(_type) || utils::isEndless(_type) || _order.size() < 2 || orderIndex + 1 < _order.size())
+		return 0;
+
+	const UInt32 board = _order[orderIndex];
+	for (Row row = 0; row < utils::VisibleRows; row++)
+		for (Column column = 0; column < utils::adaptIfIsOdd(row, _columns); column++)
+			if (peekBubble(board, row, column))
+				return row;
+	return utils::VisibleRows;
+}
+
+BubbleIdentifier HiddenBubbleContainer::peekBubble(UInt32 board, Row row, Column column) const
+{
+	if (_view)
+		return column < utils::styleToColumn(_view.getColumns()) ? _view.getBubble(board, row, column) : BubbleIdentifier::invalid();
+
+	const std::vector<BubbleIdentifier>& bubbles = (*_source)[board].peekRow(row);
+	return column < bubbles.size() ? bubbles[column] : BubbleIdentifier::invalid();
 }
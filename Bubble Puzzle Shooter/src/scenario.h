@@ -2,14 +2,18 @@
 
 #include <deque>
 
-#include "level.h"
+#include "levelpack.h"
+#include "board.h"
 
+/*
+ * Picks random colors among the available ones. The candidates are kept in a map rebuilt
+ * only when the selectable colors change, so picking a color is a single draw.
+ */
 class BubbleColorSelector
 {
 private:
 	RNG _rand;
-	BubbleColor::Mask _colors;
-	std::vector<BubbleColor> _map;
+	BubbleColor::Mask _colors = 0;
 
 public:
 	BubbleColorSelector() = default;
@@ -33,8 +37,12 @@ public:
 
 	const BubbleColor& select();
 
+	/* Available color also in filter, e.g. the colors left on the board. Any available one if none is */
+	const BubbleColor& select(BubbleColor::Mask filter);
+
 private:
-	void updateMap();
+	/* Uniform pick among the set bits of a non empty mask, without building a list of them */
+	const BubbleColor& pick(BubbleColor::Mask colors);
 };
 
 
@@ -60,6 +68,12 @@ public:
 	BubbleGenerator& operator= (const BubbleGenerator&) = default;
 	BubbleGenerator& operator= (BubbleGenerator&&) = default;
 
+	/*
+	 * Frees every bubble of the previous level, so it must be called after the board and the
+	 * hidden container have been set up for the new level, and after anything else holding a
+	 * bubble of the previous one has dropped it. Arena mode is only used when the level asks
+	 * for it and is not endless, since an arena never reuses the cells of popped bubbles.
+	 */
 	void setup(LevelProperties& props);
 
 	BubbleColor::Mask getColors() const;
@@ -73,8 +87,20 @@ public:
 
 	const BubbleColor& getLastColor() const;
 
+	const BubbleHeap& getHeap() const;
+	BubbleHeap& getHeap();
+
 	Ref<Bubble> generateFromIdentifier(const BubbleIdentifier& id, TextureManager& textures);
 
+	/*
+	 * Next bubble for the arrow. Models with onlyBoardColorInArrowGen only take colors still
+	 * present on the board, read from its live color mask.
+	 */
+	Ref<Bubble> generateArrowBubble(const BubbleBoard& board, TextureManager& textures);
+
+	/* Batched generateFromIdentifier(), one bubble or null per identifier */
+	std::vector<Ref<Bubble>> generateFromIdentifiers(std::span<const BubbleIdentifier> ids, TextureManager& textures);
+
 private:
 	RNG& rand(bool arrow);
 };
@@ -82,78 +108,39 @@ private:
 
 
 
+/*
+ * Streams the hidden boards of a level into the grid, bottom row first. Boards are read in
+ * place from the level or from a level pack and rows are only decoded and instantiated when
+ * asked for, so the container only holds a cursor and the board order of the current pass.
+ * The source must outlive the container.
+ *
+ * prepare() instantiates upcoming rows ahead of time into a small ready queue, to be called
+ * when the frame has room (bubble creation runs the model scripts, so it stays on the game
+ * thread); the generate methods then hand out ready rows first.
+ */
 class HiddenBubbleContainer
 {
-private:
-	class HiddenRow
-	{
-	private:
-		std::vector<BubbleIdentifier> _bubbles;
-		Int8 _count = -1;
-
-	public:
-		HiddenRow() = default;
-		HiddenRow(const HiddenRow&) = default;
-		HiddenRow(HiddenRow&&) = default;
-		~HiddenRow() = default;
-
-		HiddenRow& operator= (const HiddenRow&) = default;
-		HiddenRow& operator= (HiddenRow&&) = default;
-
-		HiddenRow(const std::vector<BubbleIdentifier>& bubbles);
-
-		operator bool() const;
-		bool operator! () const;
-
-		bool empty() const;
-
-		const std::vector<BubbleIdentifier>& getBubbles() const;
-		void setBubbles(const std::vector<BubbleIdentifier>& bubbles);
-
-		UInt8 getValidBubbleCount() const;
-
-		std::vector<Ref<Bubble>> generate(BubbleHeap& heap, TextureManager& textures) const;
-	};
+public:
+	static constexpr UInt32 DefaultReadyDepth = 2;
 
-	class HiddenBoard
+private:
+	struct ReadyRow
 	{
-	private:
-		std::deque<HiddenRow> _rows;
-		UInt32 _count = 0;
-		bool _modified = false;
-
-	public:
-		HiddenBoard() = default;
-		HiddenBoard(const HiddenBoard&) = default;
-		HiddenBoard(HiddenBoard&&) noexcept = default;
-		~HiddenBoard() = default;
-
-		HiddenBoard& operator= (const HiddenBoard&) = default;
-		HiddenBoard& operator= (HiddenBoard&&) noexcept = default;
-
-		operator bool() const;
-		bool operator! () const;
-
-		bool empty() const;
-
-		UInt32 getValidBubbleCount() const;
-
-		void trimTop();
-
-		void addRow(const std::vector<BubbleIdentifier>& bubbles);
-
-		std::vector<Ref<Bubble>> extractGeneratedRow(BubbleHeap& heap, TextureManager& textures);
-		std::vector<std::vector<Ref<Bubble>>> extractAllGeneratedRows(BubbleHeap& heap, TextureManager& textures);
-
-		inline void addEmptyRow() { addRow({}); }
+		std::vector<Ref<Bubble>> bubbles;
+		bool boardEnd;
 	};
 
-private:
-	std::deque<HiddenBoard> _boards;
-	ReferenceAllocator<HiddenBoard> _current;
+	const std::vector<BinaryBubbleBoard>* _source = nullptr;
+	LevelView _view;
+	std::vector<UInt32> _order;
+	UInt32 _board = 0;
+	Row _row = 0;
+	Row _rows = 0;
 	BoardColumnStyle _columns = BoardColumnStyle::Min;
 	HiddenBubbleContainerType _type = HiddenBubbleContainerType::Continuous;
 	RNG _rand;
+	std::deque<ReadyRow> _ready;
+	UInt32 _readyDepth = DefaultReadyDepth;
 
 public:
 	HiddenBubbleContainer() = default;
@@ -172,17 +159,36 @@ public:
 	void setup(LevelProperties& props);
 
 	void fill(const std::vector<BinaryBubbleBoard>& boards);
+	void fill(const LevelView& level);
 
+	/* A whole board when discrete, a single row otherwise */
 	std::vector<std::vector<Ref<Bubble>>> generate(BubbleGenerator& bgen, TextureManager& textures);
 
+	/* Remaining rows of the current board, bottom first */
 	std::vector<std::vector<Ref<Bubble>>> generateBoard(BubbleGenerator& bgen, TextureManager& textures);
 
+	/* Next row, with null bubbles on the empty cells */
 	std::vector<Ref<Bubble>> generateRow(BubbleGenerator& bgen, TextureManager& textures);
 
+	/* Bubbles still hidden in the current pass over the boards, ready ones included */
 	UInt32 getValidBubbleCount() const;
 
+	/* Instantiates up to maxRows upcoming rows while the ready queue is below its depth */
+	void prepare(BubbleGenerator& bgen, TextureManager& textures, UInt32 maxRows = 1);
+
+	UInt32 getReadyDepth() const;
+	void setReadyDepth(UInt32 rows);
+
+	UInt32 getReadyRowCount() const;
+
 private:
+	std::vector<Ref<Bubble>> decodeRow(BubbleGenerator& bgen, TextureManager& textures, bool& boardEnd);
+
+	void restart();
+	void enterBoard(UInt32 orderIndex);
 	void checkNext();
-	void addHiddenBoard(std::vector<HiddenBoard>& aux, const BinaryBubbleBoard& bbb);
-	void addHiddenRow(HiddenBoard& board, const std::vector<BubbleIdentifier>& brow, Row row);
+
+	UInt32 getBoardCount() const;
+	Row getFirstRow(UInt32 orderIndex) const;
+	BubbleIdentifier peekBubble(UInt32 board, Row row, Column column) const;
 };
@@ -0,0 +1,80 @@
+#include "spatial.h"
+
+#include <bit>
+
+
+SpatialHash::SpatialHash(float cellSize, UInt32 bucketCount) :
+	_cellSize{ cellSize },
+	_inverseCellSize{ 1.f / cellSize },
+	_bucketMask{ std::bit_ceil(std::max(bucketCount, 1U)) - 1 },
+	_starts(static_cast<size_t>(_bucketMask) + 2, 0),
+	_entries{},
+	_itemBuckets{}
+{}
+SpatialHash::~SpatialHash() {}
+
+float SpatialHash::getCellSize() const { return _cellSize; }
+UInt32 SpatialHash::getBucketCount() const { return _bucketMask + 1; }
+
+size_t SpatialHash::size() const { return _entries.size(); }
+bool SpatialHash::empty() const { return _entries.empty(); }
+
+void SpatialHash::build(std::span<const float> xs, std::span<const float> ys)
+{
+	const size_t count = std::min(xs.size(), ys.size());
+	_entries.resize(count);
+	_itemBuckets.resize(count);
+	std::fill(_starts.begin(), _starts.end(), 0);
+
+	/* Count per bucket, prefix sum, then scatter keeping the index order inside each bucket */
+	for (size_t i = 0; i < count; i++)
+	{
+		const UInt32 bucket = hash(cellOf(xs[i]), cellOf(ys[i]));
+		_itemBuckets[i] = bucket;
+		_starts[bucket + 1]++;
+	}
+
+	for (size_t i = 1; i < _starts.size(); i++)
+		_starts[i] += _starts[i - 1];
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const UInt32 bucket = _itemBuckets[i];
+		_entries[_starts[bucket]++] = static_cast<UInt32>(i);
+	}
+
+	/* The scatter left every start at the beginning of the next bucket */
+	for (size_t i = _starts.size() - 1; i > 0; i--)
+		_starts[i] = _starts[i - 1];
+	_starts[0] = 0;
+}
+
+void SpatialHash::clear()
+{
+	_entries.clear();
+	_itemBuckets.clear();
+	std::fill(_starts.begin(), _starts.end(), 0);
+}
+
+std::span<const UInt32> SpatialHash::query(const Vec2f& position) const
+{
+	return bucket(hash(cellOf(position.x), cellOf(position.y)));
+}
+
+UInt8 SpatialHash::nearBuckets(Int32 x, Int32 y, UInt32 (&buckets)[9]) const
+{
+	UInt8 count = 0;
+	for (Int32 dy = -1; dy <= 1; dy++)
+	{
+		for (Int32 dx = -1; dx <= 1; dx++)
+		{
+			const UInt32 bucket = hash(x + dx, y + dy);
+			bool repeated = false;
+			for (UInt8 i = 0; i < count && !repeated; i++)
+				repeated = buckets[i] == bucket;
+			if (!repeated)
+				buckets[count++] = bucket;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cmath>
+#include <span>
+
+#include "bubble.h"
+
+
+/*
+ * Uniform grid over free-moving objects, rebuilt from their positions every tick with a
+ * counting sort. Cells are hashed into a fixed power of two bucket count, so a bucket may
+ * hold objects of several far away cells and queries only give candidates: callers still
+ * check distances. Entries are the indices of the positions passed to build().
+ */
+class SpatialHash
+{
+public:
+	static constexpr float DefaultCellSize = static_cast<float>(Bubble::Radius * 2);
+	static constexpr UInt32 DefaultBucketCount = 4096;
+
+	/* Cell coordinates are clamped to +-MaxCell, so the 3x3 neighborhood never overflows */
+	static constexpr Int32 MaxCell = 1 << 30;
+
+private:
+	float _cellSize;
+	float _inverseCellSize;
+	UInt32 _bucketMask;
+	std::vector<UInt32> _starts;
+	std::vector<UInt32> _entries;
+	std::vector<UInt32> _itemBuckets;
+
+public:
+	/* bucketCount is rounded up to a power of two */
+	SpatialHash(float cellSize = DefaultCellSize, UInt32 bucketCount = DefaultBucketCount);
+	~SpatialHash();
+
+	NON_COPYABLE_MOVABLE(SpatialHash);
+
+	float getCellSize() const;
+	UInt32 getBucketCount() const;
+
+	size_t size() const;
+	bool empty() const;
+
+	void build(std::span<const float> xs, std::span<const float> ys);
+	void clear();
+
+	/* Entries whose cell hashes to the same bucket as position */
+	std::span<const UInt32> query(const Vec2f& position) const;
+
+	/* Calls action(UInt32 entry) for the candidates of the 3x3 cells around position */
+	template<typename _Func>
+	void forEachNear(const Vec2f& position, _Func&& action) const
+	{
+		UInt32 buckets[9];
+		const UInt8 count = nearBuckets(cellOf(position.x), cellOf(position.y), buckets);
+		for (UInt8 i = 0; i < count; i++)
+			for (UInt32 entry : bucket(buckets[i]))
+				action(entry);
+	}
+
+	/*
+	 * Calls action(UInt32 first, UInt32 second) once for every pair of entries closer than
+	 * distance, which must not exceed the cell size. xs and ys must be the ones given to build().
+	 */
+	template<typename _Func>
+	void forEachPair(std::span<const float> xs, std::span<const float> ys, float distance, _Func&& action) const
+	{
+		const float distance2 = distance * distance;
+		for (UInt32 first : _entries)
+		{
+			UInt32 buckets[9];
+			const UInt8 count = nearBuckets(cellOf(xs[first]), cellOf(ys[first]), buckets);
+			for (UInt8 i = 0; i < count; i++)
+			{
+				for (UInt32 second : bucket(buckets[i]))
+				{
+					if (second <= first)
+						continue;
+
+					const float dx = xs[second] - xs[first];
+					const float dy = ys[second] - ys[first];
+					if (dx * dx + dy * dy < distance2)
+						action(first, second);
+				}
+			}
+		}
+	}
+
+private:
+	/* Positions far outside the field and non-finite ones (NaN goes to -MaxCell) share the outermost cells */
+	inline Int32 cellOf(float coord) const
+	{
+		const float cell = std::floor(coord * _inverseCellSize);
+		if (!(cell > static_cast<float>(-MaxCell)))
+			return -MaxCell;
+		if (cell >= static_cast<float>(MaxCell))
+			return MaxCell;
+		return static_cast<Int32>(cell);
+	}
+
+	inline UInt32 hash(Int32 x, Int32 y) const
+	{
+		return ((static_cast<UInt32>(x) * 73856093U) ^ (static_cast<UInt32>(y) * 19349663U)) & _bucketMask;
+	}
+
+	inline std::span<const UInt32> bucket(UInt32 index) const
+	{
+		return { _entries.data() + _starts[index], _entries.data() + _starts[index + 1] };
+	}
+
+	/* Distinct buckets of the 3x3 cells around (x, y) */
+	UInt8 nearBuckets(Int32 x, Int32 y, UInt32 (&buckets)[9]) const;
+};